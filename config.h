@@ -9,3 +9,37 @@ static const bool USE_UTF8 = true;
 
 /* replace special characters in filenames with:      */
 static const char REPLACE_CHAR = '_';
+
+/* padding left in id3v2 tags by --compact (in bytes): */
+enum { COMPACT_PADDING = 1024 };
+
+/* only rewrite files with --compact, if this saves at least (in bytes): */
+enum { COMPACT_MIN_SAVINGS = 4096 };
+
+/* padding left in id3v2 tags by --profile, if the old tag is too small to
+ * hold the new one (in bytes): */
+enum { PROFILE_PADDING = 1024 };
+
+/* size of the buffer used for all output on stdout (in bytes): */
+enum { OUT_BUF_SIZE = 65536 };
+
+/* number of rows per block in --export-format=columns files: */
+enum { EXPORT_BLOCK_ROWS = 4096 };
+
+/* maximum number of directories kept open by -o to create subdirectories: */
+enum { DIR_CACHE_FDS = 64 };
+
+/* size and alignment of the buffers used by -o to copy files (in bytes): */
+enum { COPY_BUF_SIZE = 1048576, COPY_BUF_ALIGN = 4096 };
+
+/* maximum size of the files being copied in parallel with --jobs (in bytes),
+ * a single larger file is still copied: */
+enum { COPY_MAX_IN_FLIGHT = 268435456 };
+
+/* number of files modified with --safe-write, which are synced to disk and
+ * replace the originals together: */
+enum { SAFE_WRITE_BATCH = 256 };
+
+/* size of the blocks read to hash the audio data with --audio-hash
+ * (in bytes): */
+enum { AUDIO_HASH_BUF_SIZE = 1048576 };
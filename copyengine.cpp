@@ -0,0 +1,150 @@
+/* id3ted: copyengine.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdlib>
+
+#include "copyengine.h"
+
+CopyEngine::CopyEngine(uint count, long _maxInFlight) :
+		running(0), inFlight(0), maxInFlight(_maxInFlight), stop(false),
+		failed(false) {
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&queued, NULL);
+	pthread_cond_init(&finished, NULL);
+
+	for (uint i = 0; i < count; ++i) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, work, this) != 0) {
+			warn("Could not create copy thread");
+			break;
+		}
+		threads.push_back(thread);
+	}
+}
+
+CopyEngine::~CopyEngine() {
+	wait();
+
+	pthread_mutex_lock(&mutex);
+	stop = true;
+	pthread_cond_broadcast(&queued);
+	pthread_mutex_unlock(&mutex);
+
+	for (uint i = 0; i < threads.size(); ++i)
+		pthread_join(threads[i], NULL);
+
+	pthread_cond_destroy(&finished);
+	pthread_cond_destroy(&queued);
+	pthread_mutex_destroy(&mutex);
+}
+
+/* copy file from to to in the background, see FileIO::transfer() */
+void CopyEngine::submit(const char *from, const char *to, bool create,
+                        long size, const FileTimes *times) {
+	Job job;
+
+	job.from = from;
+	job.to = to;
+	job.create = create;
+	job.size = size > 0 ? size : 0;
+	job.setTimes = times != NULL;
+	if (times != NULL)
+		job.times = *times;
+
+	if (threads.empty()) {
+		// no threads available: copy in the foreground
+		void *buffer = NULL;
+		if (posix_memalign(&buffer, COPY_BUF_ALIGN, COPY_BUF_SIZE) != 0 ||
+				FileIO::transfer(from, to, create, size, times, (char*) buffer,
+				                 COPY_BUF_SIZE) != FileIO::Success)
+			failed = true;
+		free(buffer);
+		return;
+	}
+
+	pthread_mutex_lock(&mutex);
+	if (paths.count(job.from) > 0 || paths.count(job.to) > 0) {
+		while (!idle())
+			pthread_cond_wait(&finished, &mutex);
+	}
+	while (inFlight > 0 && inFlight + job.size > maxInFlight)
+		pthread_cond_wait(&finished, &mutex);
+
+	jobs.push_back(job);
+	paths.insert(job.from);
+	paths.insert(job.to);
+	inFlight += job.size;
+	pthread_cond_signal(&queued);
+	pthread_mutex_unlock(&mutex);
+}
+
+/* wait for all submitted copies, false if any copy has failed so far */
+bool CopyEngine::wait() {
+	bool success;
+
+	pthread_mutex_lock(&mutex);
+	while (!idle())
+		pthread_cond_wait(&finished, &mutex);
+	success = !failed;
+	pthread_mutex_unlock(&mutex);
+
+	return success;
+}
+
+void* CopyEngine::work(void *engine) {
+	((CopyEngine*) engine)->run();
+	return NULL;
+}
+
+void CopyEngine::run() {
+	void *buffer = NULL;
+	bool error = posix_memalign(&buffer, COPY_BUF_ALIGN, COPY_BUF_SIZE) != 0;
+
+	pthread_mutex_lock(&mutex);
+	while (true) {
+		while (jobs.empty() && !stop)
+			pthread_cond_wait(&queued, &mutex);
+		if (jobs.empty())
+			break;
+
+		Job job = jobs.front();
+		jobs.pop_front();
+		++running;
+		pthread_mutex_unlock(&mutex);
+
+		FileIO::Status ret = FileIO::Error;
+		if (!error)
+			ret = FileIO::transfer(job.from.c_str(), job.to.c_str(), job.create,
+			                       job.size, job.setTimes ? &job.times : NULL,
+			                       (char*) buffer, COPY_BUF_SIZE);
+		else
+			warn("%s: Could not allocate copy buffer", job.to.c_str());
+
+		pthread_mutex_lock(&mutex);
+		if (ret != FileIO::Success)
+			failed = true;
+		paths.erase(job.from);
+		paths.erase(job.to);
+		inFlight -= job.size;
+		--running;
+		pthread_cond_broadcast(&finished);
+	}
+	pthread_mutex_unlock(&mutex);
+
+	free(buffer);
+}
@@ -0,0 +1,71 @@
+/* id3ted: copyengine.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COPYENGINE_H
+#define COPYENGINE_H
+
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+/* copies files in the background with a fixed number of threads, so that
+ * the next files can be processed while the previous ones are copied.
+ * submit() blocks while the files queued or being copied exceed
+ * COPY_MAX_IN_FLIGHT bytes in total, and waits for all the copies to
+ * finish first, if the source or target is already involved in one. */
+class CopyEngine {
+	public:
+		CopyEngine(uint, long);
+		~CopyEngine();
+
+		void submit(const char*, const char*, bool, long, const FileTimes*);
+		bool wait();
+
+	private:
+		typedef struct {
+			string from;
+			string to;
+			bool create;
+			long size;
+			bool setTimes;
+			FileTimes times;
+		} Job;
+
+		vector<pthread_t> threads;
+		pthread_mutex_t mutex;
+		pthread_cond_t queued;
+		pthread_cond_t finished;
+		deque<Job> jobs;
+		set<string> paths;
+		uint running;
+		long inFlight;
+		long maxInFlight;
+		bool stop;
+		bool failed;
+
+		static void* work(void*);
+		void run();
+		bool idle() const { return jobs.empty() && running == 0; }
+};
+
+#endif /* COPYENGINE_H */
@@ -0,0 +1,126 @@
+/* id3ted: dircache.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dircache.h"
+
+DirCache::~DirCache() {
+	map<string, Dir>::iterator dir;
+
+	for (dir = dirs.begin(); dir != dirs.end(); ++dir) {
+		if (dir->second.fd != -1)
+			close(dir->second.fd);
+	}
+}
+
+/* create directory path and all its missing parents, device is set to the
+ * device it resides on */
+FileIO::Status DirCache::create(const char *path, dev_t &device) {
+	string directory(path);
+	Dir dir;
+
+	while (directory.size() > 1 && directory[directory.size() - 1] == '/')
+		directory.erase(directory.size() - 1);
+	if (directory.empty())
+		directory = ".";
+
+	if (lookup(directory, dir) != FileIO::Success)
+		return FileIO::Error;
+	device = dir.device;
+
+	return FileIO::Success;
+}
+
+FileIO::Status DirCache::lookup(const string &path, Dir &dir) {
+	map<string, Dir>::iterator cached = dirs.find(path);
+	size_t slash = path.rfind('/');
+	struct stat stats;
+	const char *name;
+	int at = AT_FDCWD;
+
+	if (cached != dirs.end()) {
+		dir = cached->second;
+		return FileIO::Success;
+	}
+
+	if (path == "/" || slash == string::npos) {
+		name = path.c_str();
+	} else {
+		string parentPath(path, 0, slash);
+		Dir parent;
+
+		while (parentPath.size() > 1 && parentPath[parentPath.size() - 1] == '/')
+			parentPath.erase(parentPath.size() - 1);
+		if (parentPath.empty())
+			parentPath = "/";
+		if (lookup(parentPath, parent) != FileIO::Success)
+			return FileIO::Error;
+
+		if (parent.fd != -1) {
+			at = parent.fd;
+			name = path.c_str() + slash + 1;
+		} else {
+			name = path.c_str();
+		}
+	}
+
+	if (mkdirat(at, name, 0755) != 0 && errno != EEXIST) {
+		warn("%s: Could not create directory", path.c_str());
+		return FileIO::Error;
+	}
+
+	dir.fd = -1;
+	if (openFds < DIR_CACHE_FDS) {
+		dir.fd = openat(at, name, O_RDONLY | O_DIRECTORY);
+		if (dir.fd == -1 && errno == ENOTDIR) {
+			warn("%s: Not a directory", path.c_str());
+			return FileIO::Error;
+		}
+	}
+	if (dir.fd != -1) {
+		++openFds;
+		if (fcntl(dir.fd, F_SETFD, FD_CLOEXEC) != 0 || fstat(dir.fd, &stats) != 0) {
+			close(dir.fd);
+			--openFds;
+			dir.fd = -1;
+		}
+	}
+	// not readable or too many open: continue with full paths for this one
+	if (dir.fd == -1 && fstatat(at, name, &stats, 0) != 0) {
+		warn("%s: %s", path.c_str(), strerror(errno));
+		return FileIO::Error;
+	}
+	if (!S_ISDIR(stats.st_mode)) {
+		warn("%s: Not a directory", path.c_str());
+		if (dir.fd != -1) {
+			close(dir.fd);
+			--openFds;
+		}
+		return FileIO::Error;
+	}
+
+	dir.device = stats.st_dev;
+	dirs[path] = dir;
+
+	return FileIO::Success;
+}
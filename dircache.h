@@ -0,0 +1,53 @@
+/* id3ted: dircache.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <map>
+#include <string>
+#include <sys/types.h>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+/* remembers the directories already known to exist or created during the
+ * run, so that putting many files into the same directory costs only one
+ * lookup instead of checking every path component for every file.
+ * a new directory is created relative to its cached parent with mkdirat(),
+ * up to DIR_CACHE_FDS of the directories are kept open for that. */
+class DirCache {
+	public:
+		DirCache() : openFds(0) {}
+		~DirCache();
+
+		FileIO::Status create(const char*, dev_t&);
+
+	private:
+		typedef struct {
+			int fd;
+			dev_t device;
+		} Dir;
+
+		map<string, Dir> dirs;
+		uint openFds;
+
+		FileIO::Status lookup(const string&, Dir&);
+};
+
+#endif /* DIRCACHE_H */
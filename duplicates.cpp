@@ -0,0 +1,139 @@
+/* id3ted: duplicates.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+
+#include "duplicates.h"
+#include "mp3file.h"
+#include "writer.h"
+
+/* frames compared between duplicates */
+const char *Duplicates::keyFrames[] = {
+	"TPE1", "TPE2", "TALB", "TIT2", "TRCK", "TPOS", "TDRC", "TCON"
+};
+
+bool Duplicates::add(MP3File &file) {
+	long length;
+	uint64_t digest;
+
+	if (!file.hashAudio(length, digest)) {
+		warn("%s: Could not read audio data", file.filename());
+		return false;
+	}
+
+	entries.push_back(Entry());
+	Entry &entry = entries.back();
+	entry.path = file.filename();
+	for (int i = 0; i < KEY_FRAMES; ++i)
+		entry.texts.push_back(file.frameText(keyFrames[i]));
+	groups[Key(length, digest)].push_back(entries.size() - 1);
+
+	return true;
+}
+
+void Duplicates::print() const {
+	Writer &out = Writer::out;
+	unsigned long sets = 0, files = 0, wasted = 0;
+	Groups::const_iterator group;
+
+	for (group = groups.begin(); group != groups.end(); ++group) {
+		if (group->second.size() > 1) {
+			++sets;
+			files += group->second.size();
+			wasted += (group->second.size() - 1) * group->first.first;
+		}
+	}
+
+	out << "duplicate sets: " << sets << ", files: " << files
+	    << ", excess audio data: ";
+	out.putSize(wasted) << '\n';
+
+	for (group = groups.begin(); group != groups.end(); ++group) {
+		const vector<size_t> &members = group->second;
+		if (members.size() < 2)
+			continue;
+
+		out << "\naudio ";
+		out.putHex(group->first.second >> 32, 8);
+		out.putHex(group->first.second & 0xFFFFFFFF, 8) << ", ";
+		out.putSize(group->first.first) << ":\n";
+
+		vector<size_t>::const_iterator member = members.begin();
+		for (; member != members.end(); ++member) {
+			const Entry &entry = entries[*member];
+			out << "  " << entry.path.c_str() << '\n';
+			for (int i = 0; i < KEY_FRAMES; ++i) {
+				if (differs(members, i)) {
+					out << "    ";
+					out.putPadded(keyFrames[i], 6) << entry.texts[i] << '\n';
+				}
+			}
+		}
+	}
+}
+
+void Duplicates::write(JsonWriter &json) const {
+	char hex[17];
+
+	json.beginArray();
+	Groups::const_iterator group = groups.begin();
+	for (; group != groups.end(); ++group) {
+		const vector<size_t> &members = group->second;
+		if (members.size() < 2)
+			continue;
+
+		snprintf(hex, sizeof(hex), "%08X%08X",
+		         (uint) (group->first.second >> 32),
+		         (uint) (group->first.second & 0xFFFFFFFF));
+		json.beginObject();
+		json.key("audio_hash");
+		json.value(hex);
+		json.key("audio_size");
+		json.value(group->first.first);
+		json.key("files");
+		json.beginArray();
+		vector<size_t>::const_iterator member = members.begin();
+		for (; member != members.end(); ++member) {
+			const Entry &entry = entries[*member];
+			json.beginObject();
+			json.key("file");
+			json.value(entry.path.c_str());
+			for (int i = 0; i < KEY_FRAMES; ++i) {
+				if (differs(members, i)) {
+					json.key(keyFrames[i]);
+					json.value(entry.texts[i]);
+				}
+			}
+			json.endObject();
+		}
+		json.endArray();
+		json.endObject();
+	}
+	json.endArray();
+}
+
+/* do the texts of the given frame differ between the members of a set? */
+bool Duplicates::differs(const vector<size_t> &members, int frame) const {
+	const String &first = entries[members[0]].texts[frame];
+
+	for (size_t i = 1; i < members.size(); ++i) {
+		if (entries[members[i]].texts[frame] != first)
+			return true;
+	}
+	return false;
+}
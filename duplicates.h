@@ -0,0 +1,64 @@
+/* id3ted: duplicates.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DUPLICATES_H
+#define DUPLICATES_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "id3ted.h"
+#include "jsonwriter.h"
+
+class MP3File;
+
+/* finds the files with identical audio data for --audio-hash: every file
+ * is added with the length and hash of its mpeg payload (without any
+ * tags) and the texts of its main frames, the files with the same
+ * payload are reported as duplicates together with the frames, in which
+ * their tags differ. */
+class Duplicates {
+	public:
+		bool add(MP3File&);
+
+		void print() const;
+		void write(JsonWriter&) const;
+
+	private:
+		typedef pair<long, uint64_t> Key;
+		typedef map<Key, vector<size_t> > Groups;
+
+		typedef struct {
+			string path;
+			vector<String> texts;
+		} Entry;
+
+		enum { KEY_FRAMES = 8 };
+
+		vector<Entry> entries;
+		Groups groups;
+
+		static const char *keyFrames[];
+
+		bool differs(const vector<size_t>&, int) const;
+};
+
+#endif /* DUPLICATES_H */
@@ -0,0 +1,273 @@
+/* id3ted: exporter.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include "exporter.h"
+
+const ColumnInfo Exporter::columns[] = {
+	{ "path",        false, 1,  true },
+	{ "size",        true,  1,  false },
+	{ "TPE1",        false, 1,  false },
+	{ "TPE2",        false, 1,  false },
+	{ "TALB",        false, 1,  false },
+	{ "TIT2",        false, 1,  false },
+	{ "TRCK",        false, 1,  false },
+	{ "TPOS",        false, 1,  false },
+	{ "TDRC",        false, 1,  false },
+	{ "TCON",        false, 1,  false },
+	{ "bitrate",     true,  1,  false },
+	{ "sample_rate", true,  1,  false },
+	{ "length",      true,  1,  false },
+	{ "encoder",     false, 1,  false },
+	{ "track_gain",  true,  10, false },
+	{ "album_gain",  true,  10, false }
+};
+
+void ExportRow::clear() {
+	for (uint i = 0; i < values.size(); ++i) {
+		values[i].isSet = false;
+		values[i].text.clear();
+		values[i].number = 0;
+	}
+}
+
+void ExportRow::set(ExportColumn col, const String &text) {
+	if (text.isEmpty())
+		return;
+	values[col].isSet = true;
+	values[col].text = text.toCString(USE_UTF8);
+}
+
+/* raw bytes, e.g. paths, which need not be valid utf-8 */
+void ExportRow::set(ExportColumn col, const char *text) {
+	if (text == NULL || *text == '\0')
+		return;
+	values[col].isSet = true;
+	values[col].text = text;
+}
+
+void ExportRow::set(ExportColumn col, long number) {
+	values[col].isSet = true;
+	values[col].number = number;
+}
+
+Exporter* Exporter::create(ExportFormat format, const char *path) {
+	Exporter *exporter;
+
+	if (format == EXPORT_COLUMNS)
+		exporter = new ColumnExporter(path);
+	else
+		exporter = new TsvExporter(path);
+
+	if (!exporter->isOpen()) {
+		delete exporter;
+		return NULL;
+	}
+	return exporter;
+}
+
+Exporter::Exporter(const char *_path) :
+		path(_path), stream(NULL), writer(NULL) {
+	if (strcmp(path, "-") == 0) {
+		writer = &Writer::out;
+		return;
+	}
+	if ((stream = fopen(path, "w")) == NULL) {
+		warn("%s: %s", path, strerror(errno));
+		return;
+	}
+	writer = new Writer(stream);
+}
+
+Exporter::~Exporter() {
+	if (stream != NULL) {
+		delete writer;
+		fclose(stream);
+	}
+}
+
+/* write everything still buffered, return false on any write error */
+bool Exporter::finish() {
+	bool success = writer->flush();
+
+	if (stream != NULL) {
+		delete writer;
+		writer = NULL;
+		if (fclose(stream) != 0)
+			success = false;
+		stream = NULL;
+	}
+	if (!success)
+		warn("%s: Could not write export", path);
+
+	return success;
+}
+
+TsvExporter::TsvExporter(const char *_path) : Exporter(_path) {
+	if (!isOpen())
+		return;
+
+	for (int col = 0; col < EXP_COLUMNS; ++col) {
+		if (col > 0)
+			*writer << '\t';
+		*writer << columns[col].name;
+	}
+	*writer << '\n';
+}
+
+void TsvExporter::add(const ExportRow &row) {
+	for (int col = 0; col < EXP_COLUMNS; ++col) {
+		if (col > 0)
+			*writer << '\t';
+		if (!row.isSet(col))
+			continue;
+		if (!columns[col].numeric)
+			putEscaped(row.text(col));
+		else if (columns[col].scale == 1)
+			*writer << row.number(col);
+		else
+			writer->putFixed((double) row.number(col) / columns[col].scale, 1);
+	}
+	*writer << '\n';
+}
+
+void TsvExporter::putEscaped(const string &text) {
+	const char *s = text.c_str();
+	const char *run = s;
+
+	for (; *s != '\0'; ++s) {
+		char escape;
+
+		switch (*s) {
+			case '\t': escape = 't'; break;
+			case '\n': escape = 'n'; break;
+			case '\r': escape = 'r'; break;
+			case '\\': escape = '\\'; break;
+			default: continue;
+		}
+		writer->write(run, s - run);
+		*writer << '\\' << escape;
+		run = s + 1;
+	}
+	writer->write(run, s - run);
+}
+
+ColumnExporter::ColumnExporter(const char *_path) :
+		Exporter(_path), rows(0), dictionaries(EXP_COLUMNS),
+		newEntries(EXP_COLUMNS), values(EXP_COLUMNS) {
+	if (!isOpen())
+		return;
+
+	writer->write("ID3TCOL\1", 8);
+	putVarint(EXP_COLUMNS);
+	for (int col = 0; col < EXP_COLUMNS; ++col) {
+		putVarint(columns[col].numeric ? 1 : columns[col].plain ? 2 : 0);
+		putVarint(columns[col].scale);
+		putString(columns[col].name);
+	}
+	for (int col = 0; col < EXP_COLUMNS; ++col)
+		values[col].reserve(EXPORT_BLOCK_ROWS);
+}
+
+void ColumnExporter::add(const ExportRow &row) {
+	for (int col = 0; col < EXP_COLUMNS; ++col) {
+		unsigned long value = 0;
+
+		if (!row.isSet(col)) {
+			// null
+		} else if (columns[col].numeric) {
+			long number = row.number(col);
+			value = (((unsigned long) number << 1) ^
+			         (number < 0 ? ~0UL : 0UL)) + 1;
+		} else if (columns[col].plain) {
+			newEntries[col].push_back(row.text(col));
+			value = 1;
+		} else {
+			map<string, uint> &dictionary = dictionaries[col];
+			map<string, uint>::iterator entry = dictionary.find(row.text(col));
+			if (entry == dictionary.end()) {
+				uint index = dictionary.size() + 1;
+				entry = dictionary.insert(make_pair(row.text(col), index)).first;
+				newEntries[col].push_back(row.text(col));
+			}
+			value = entry->second;
+		}
+		values[col].push_back(value);
+	}
+
+	if (++rows == EXPORT_BLOCK_ROWS)
+		writeBlock();
+}
+
+bool ColumnExporter::finish() {
+	if (rows > 0)
+		writeBlock();
+	putVarint(0);
+
+	return Exporter::finish();
+}
+
+void ColumnExporter::writeBlock() {
+	putVarint(rows);
+	for (int col = 0; col < EXP_COLUMNS; ++col) {
+		vector<string> &entries = newEntries[col];
+
+		if (columns[col].plain) {
+			// the strings of the rows with a value, in order
+			for (uint i = 0, next = 0; i < rows; ++i) {
+				if (values[col][i] == 0) {
+					putVarint(0);
+				} else {
+					putVarint(entries[next].length() + 1);
+					writer->write(entries[next].data(), entries[next].length());
+					++next;
+				}
+			}
+		} else {
+			if (!columns[col].numeric) {
+				putVarint(entries.size());
+				for (uint i = 0; i < entries.size(); ++i)
+					putString(entries[i]);
+			}
+			for (uint i = 0; i < rows; ++i)
+				putVarint(values[col][i]);
+		}
+		entries.clear();
+		values[col].clear();
+	}
+	rows = 0;
+}
+
+void ColumnExporter::putVarint(unsigned long value) {
+	char bytes[10];
+	int len = 0;
+
+	while (value >= 0x80) {
+		bytes[len++] = (char) ((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	bytes[len++] = (char) value;
+	writer->write(bytes, len);
+}
+
+void ColumnExporter::putString(const string &text) {
+	putVarint(text.length());
+	writer->write(text.data(), text.length());
+}
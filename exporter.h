@@ -0,0 +1,158 @@
+/* id3ted: exporter.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "id3ted.h"
+#include "writer.h"
+
+enum ExportFormat {
+	EXPORT_TSV,
+	EXPORT_COLUMNS
+};
+
+/* the fixed columns of an export, in order */
+enum ExportColumn {
+	EXP_PATH,
+	EXP_SIZE,
+	EXP_TPE1,
+	EXP_TPE2,
+	EXP_TALB,
+	EXP_TIT2,
+	EXP_TRCK,
+	EXP_TPOS,
+	EXP_TDRC,
+	EXP_TCON,
+	EXP_BITRATE,
+	EXP_SAMPLE_RATE,
+	EXP_LENGTH,
+	EXP_ENCODER,
+	EXP_TRACK_GAIN,
+	EXP_ALBUM_GAIN,
+	EXP_COLUMNS
+};
+
+typedef struct {
+	const char *name;
+	bool numeric;
+	int scale;  // numeric values are stored multiplied by scale
+	bool plain; // mostly unique strings, not dictionary encoded
+} ColumnInfo;
+
+/* the values of one file, unset values are exported as empty/null */
+class ExportRow {
+	public:
+		ExportRow() : values(EXP_COLUMNS) {}
+
+		void clear();
+		void set(ExportColumn, const String&);
+		void set(ExportColumn, const char*);
+		void set(ExportColumn, long);
+
+		bool isSet(int col) const { return values[col].isSet; }
+		const string& text(int col) const { return values[col].text; }
+		long number(int col) const { return values[col].number; }
+
+	private:
+		typedef struct {
+			bool isSet;
+			string text;
+			long number;
+		} Value;
+
+		vector<Value> values;
+};
+
+/* writes one row per file to the file given with --export ("-" for stdout),
+ * every row is written as soon as it is added. */
+class Exporter {
+	public:
+		static Exporter* create(ExportFormat, const char*);
+		virtual ~Exporter();
+
+		bool isOpen() const { return writer != NULL; }
+		virtual void add(const ExportRow&) = 0;
+		virtual bool finish();
+
+		static const ColumnInfo columns[];
+
+	protected:
+		explicit Exporter(const char*);
+
+		const char *path;
+		FILE *stream;
+		Writer *writer;
+};
+
+/* tab separated values with a header line, tabs, newlines and backslashes
+ * in the values are escaped with a backslash */
+class TsvExporter : public Exporter {
+	public:
+		explicit TsvExporter(const char*);
+
+		void add(const ExportRow&);
+
+	private:
+		void putEscaped(const string&);
+};
+
+/* compact binary format, which stores the values column by column in
+ * blocks of EXPORT_BLOCK_ROWS rows, string columns are dictionary encoded,
+ * except for the ones with mostly unique values like the path.
+ * all integers are unsigned LEB128 varints:
+ *
+ *   file    := "ID3TCOL" 0x01 ncolumns column* block* 0x00
+ *   column  := type (0: string, 1: number, 2: plain string) scale
+ *              namelen name
+ *   block   := nrows data* (one per column, in order)
+ *   string data := nentries (len bytes)* index*
+ *                  the new dictionary entries of the column, followed by
+ *                  the indices of the nrows values; 0 is null, i > 0 is the
+ *                  i-th entry of all the column's entries up to this block
+ *   number data := value*
+ *                  0 is null, otherwise zigzag(n) + 1
+ *   plain string data := (len bytes)*
+ *                  0 is null, otherwise len is the length + 1
+ *
+ * so every distinct string is only written once and a reader only has to
+ * append to the dictionaries while reading the blocks sequentially. */
+class ColumnExporter : public Exporter {
+	public:
+		explicit ColumnExporter(const char*);
+
+		void add(const ExportRow&);
+		bool finish();
+
+	private:
+		void writeBlock();
+		void putVarint(unsigned long);
+		void putString(const string&);
+
+		uint rows;
+		vector<map<string, uint> > dictionaries;
+		vector<vector<string> > newEntries;
+		vector<vector<unsigned long> > values;
+};
+
+#endif /* EXPORTER_H */
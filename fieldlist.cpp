@@ -0,0 +1,99 @@
+/* id3ted: fieldlist.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cctype>
+
+#include "fieldlist.h"
+
+/* parse a comma separated list of field names */
+bool FieldList::parse(const char *list) {
+	const char *end;
+
+	for (; *list != '\0'; list = *end != '\0' ? end + 1 : end) {
+		for (end = list; *end != '\0' && *end != ','; ++end);
+		string name(list, end - list);
+		int type = 0;
+
+		if (name.empty())
+			continue;
+
+		if (name.length() == 4 && isupper(name[0]) && isalnum(name[1]) &&
+				isalnum(name[2]) && isalnum(name[3]))
+			type |= FIELD_FRAME;
+		if (find(infoFields, name))
+			type |= FIELD_INFO;
+		if (find(lameFields, name))
+			type |= FIELD_LAME;
+
+		if (type == 0) {
+			warn("--fields: unknown field: %s", name.c_str());
+			return false;
+		}
+		names.push_back(name);
+		types |= type;
+	}
+
+	return true;
+}
+
+bool FieldList::contains(const char *name) const {
+	if (names.empty())
+		return true;
+
+	vector<string>::const_iterator each = names.begin();
+	for (; each != names.end(); ++each) {
+		if (*each == name)
+			return true;
+	}
+	return false;
+}
+
+bool FieldList::contains(const ByteVector &frameID) const {
+	if (names.empty())
+		return true;
+
+	vector<string>::const_iterator each = names.begin();
+	for (; each != names.end(); ++each) {
+		if (each->length() == frameID.size() &&
+				each->compare(0, string::npos, frameID.data(), frameID.size()) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool FieldList::find(const char **list, const string &name) {
+	for (; *list != NULL; ++list) {
+		if (name == *list)
+			return true;
+	}
+	return false;
+}
+
+const char *FieldList::infoFields[] = {
+	"version", "layer", "channel_mode", "bitrate", "sample_rate", "length",
+	NULL
+};
+
+const char *FieldList::lameFields[] = {
+	"encoder", "revision", "encoding_method", "quality", "stereo_mode",
+	"source_rate", "bitrate", "music_length", "lowpass", "mp3gain",
+	"ath_type", "encoding_flags", "encoding_delay", "padding",
+	"noise_shaping", "unwise_settings", "tag_crc", "tag_crc_correct",
+	"music_crc", "music_crc_correct", "peak_signal", "track_gain",
+	"album_gain", NULL
+};
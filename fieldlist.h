@@ -0,0 +1,58 @@
+/* id3ted: fieldlist.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef FIELDLIST_H
+#define FIELDLIST_H
+
+#include <string>
+#include <vector>
+
+#include <taglib/tbytevector.h>
+
+#include "id3ted.h"
+
+enum FieldType {
+	FIELD_FRAME = 1,  // id3v2 frame id
+	FIELD_INFO  = 2,  // audio property (-i)
+	FIELD_LAME  = 4   // lame tag field (-m)
+};
+
+/* the fields selected with --fields: id3v2 frame ids and the names of
+ * the audio properties and lame tag fields used in the json output.
+ * an empty list selects everything. */
+class FieldList {
+	public:
+		FieldList() : types(0) {}
+
+		bool parse(const char*);
+
+		bool isEmpty() const { return names.empty(); }
+		bool selects(FieldType type) const { return names.empty() || types & type; }
+		bool contains(const char*) const;
+		bool contains(const ByteVector&) const;
+
+	private:
+		vector<string> names;
+		int types;
+
+		static const char *infoFields[];
+		static const char *lameFields[];
+		static bool find(const char**, const string&);
+};
+
+#endif /* FIELDLIST_H */
@@ -18,19 +18,31 @@
 
 #include <cstring>
 #include <cstdlib>
-#include <sstream>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <magic.h>
 
 #include <taglib/tfile.h>
 
+#include "copyengine.h"
+#include "dircache.h"
 #include "fileio.h"
 #include "options.h"
+#include "writer.h"
 
 #define FILECPY_BUFSIZE 4096
 
+#if defined(__linux__) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define HAVE_COPY_FILE_RANGE
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define HAVE_FALLOCATE
+#endif
+
 #ifdef __APPLE__
 #define st_atim st_atimespec
 #define st_mtim st_mtimespec
@@ -43,6 +55,10 @@
 }
 #endif
 
+static DirCache dirCache;
+
+CopyEngine *FileIO::copyEngine = NULL;
+
 bool FileIO::exists(const char *path) {
 	return !access(path, F_OK);
 }
@@ -67,33 +83,15 @@ bool FileIO::isWritable(const char *path) {
 	return TagLib::File::isWritable(path);
 }
 
-string FileIO::sizeHumanReadable(unsigned long size) {
-	float size_hr = size;
-	const char *unit = NULL;
-	ostringstream ret;
-
-	ret.setf(ios::fixed);
-	ret.precision(2);
+long FileIO::size(const char *path) {
+	struct stat stats;
 
-	if (size_hr >= 1024) {
-		size_hr /= 1024;
-		unit = "KB";
-	}
-	if (size_hr >= 1024) {
-		size_hr /= 1024;
-		unit = "MB";
-	}
-	if (size_hr >= 1024) {
-		size_hr /= 1024;
-		unit = "GB";
+	if (stat(path, &stats) == -1) {
+		warn("%s: Could not stat file", path);
+		return -1;
 	}
 
-	if (size != size_hr)
-		ret << size_hr << " " << unit << " (" << size << " bytes)";
-	else
-		ret << size << " bytes";
-
-	return ret.str();
+	return stats.st_size;
 }
 
 const char* FileIO::mimetype(const char *file) {
@@ -154,32 +152,15 @@ FileIO::Status FileIO::resetTimes(const char *filename, const FileTimes &times)
 }
 
 FileIO::Status FileIO::createDir(const char *path) {
-	char *directory = new char[strlen(path) + 1];
-	char *curr = directory;
-	struct stat stats;
-	Status ret = Success;
-
-	strcpy(directory, path);
-	while (curr != NULL && ret == Success) {
-		curr = strchr(curr + 1, '/');
-		if (curr != NULL)
-			*curr = '\0';
-		if (access(directory, F_OK) != 0 && errno == ENOENT) {
-			if (mkdir(directory, 0755) != 0) {
-				warn("%s: Could not create directory", directory);
-				ret = Error;
-			}
-		} else if (stat(directory, &stats) != 0 || !(stats.st_mode & S_IFDIR)) {
-			warn("%s: Not a directory", directory);
-			ret = Error;
-		}
-		if (curr != NULL)
-			*curr = '/';
-	}
-	if (directory != NULL)
-		delete [] directory;
+	dev_t device;
 
-	return ret;
+	return createDir(path, device);
+}
+
+/* create directory path including its parents, device is set to the
+ * device it resides on; directories are only looked at once per run */
+FileIO::Status FileIO::createDir(const char *path, dev_t &device) {
+	return dirCache.create(path, device);
 }
 
 bool FileIO::confirmOverwrite(const char *filename) {
@@ -187,6 +168,9 @@ bool FileIO::confirmOverwrite(const char *filename) {
 	char *userIn;
 	bool ret = false;
 
+	// the question has to appear after all the output written so far
+	Writer::out.flush();
+
 	while (1) {
 		printf("overwrite `%s'? [yN] ", filename);
 		userIn = fgets(buffer, 10, stdin);
@@ -206,7 +190,10 @@ bool FileIO::confirmOverwrite(const char *filename) {
 	return ret;
 }
 
-FileIO::Status FileIO::copy(const char *from, const char *to) {
+/* copy (or move/link) file from to to, creating the directories, overwrite
+ * tells what to do if to already exists; times are applied to to, if given */
+FileIO::Status FileIO::copy(const char *from, const char *to,
+                            Overwrite overwrite, const FileTimes *times) {
 	String path(to, DEF_TSTR_ENC);
 
 	path = path.stripWhiteSpace();
@@ -230,23 +217,11 @@ FileIO::Status FileIO::copy(const char *from, const char *to) {
 	stat(from, &fromStats);
 
 	if (directory != NULL) {
-		if (access(directory, W_OK) != 0) {
-			if (errno == ENOENT) {
-				if (FileIO::createDir(directory) != Success)
-					return Error;
-			} else {
-				warn("%s: %s", directory, strerror(errno));
-				return Error;
-			}
-		}
+		dev_t device;
 
-		stat(directory, &toStats);
-		if (!(toStats.st_mode & S_IFDIR)) {
-			warn("%s: Not a directory", directory);
+		if (FileIO::createDir(directory, device) != Success)
 			return Error;
-		}
-
-		if (toStats.st_dev == fromStats.st_dev)
+		if (device == fromStats.st_dev)
 			sameFS = true;
 	}
 
@@ -269,7 +244,10 @@ FileIO::Status FileIO::copy(const char *from, const char *to) {
 			if (access(to, W_OK) != 0) {
 				warn("%s: Permission denied", to);
 				return Error;
-			} else if (!Options::forceOverwrite) {
+			} else if (overwrite == Never) {
+				warn("%s: File exists", to);
+				return Error;
+			} else if (overwrite == Ask) {
 				/* have to ask the user if he wants to overwrite the file */
 				if (!FileIO::confirmOverwrite(to)) {
 					return Abort;
@@ -278,58 +256,247 @@ FileIO::Status FileIO::copy(const char *from, const char *to) {
 		}
 	}
 
+	if (Options::symlinkFiles || (Options::linkFiles && sameFS)) {
+		Status ret = FileIO::makeLink(from, to, !create);
+		if (ret == Success && times != NULL)
+			FileIO::resetTimes(to, *times);
+		if (ret != Abort)
+			return ret;
+		/* the filesystem doesn't support it, copy the file instead */
+	}
+
 	if (Options::moveFiles && sameFS) {
 		/* simply rename the file */
 		if (rename(from, to) != 0) {
 			warn("%s: Could not rename file to: %s", from, to);
 			return Error;
 		}
-	} else {
-		/* copy file to new position */
-		IFile inFile(from);
-		OFile outFile(to);
+		if (times != NULL)
+			FileIO::resetTimes(to, *times);
+		return Success;
+	}
 
-		bool error = inFile.error() || outFile.error();
-		char *buf = new char[FILECPY_BUFSIZE];
-		int icnt, ocnt;
+	if (copyEngine != NULL) {
+		/* copied in the background, errors are reported by the engine */
+		copyEngine->submit(from, to, create, fromStats.st_size, times);
+		return Success;
+	}
 
-		/* copy content of inFile to outFile */
-		while (!inFile.eof() && !error) {
-			icnt = inFile.read(buf, FILECPY_BUFSIZE);
-			if (inFile.error()) {
-				warn("%s: Could not read file", from);
+	void *buffer;
+	if (posix_memalign(&buffer, COPY_BUF_ALIGN, COPY_BUF_SIZE) != 0) {
+		warn("%s: Could not allocate copy buffer", to);
+		return Error;
+	}
+	Status ret = FileIO::transfer(from, to, create, fromStats.st_size, times,
+	                              (char*) buffer, COPY_BUF_SIZE);
+	free(buffer);
+
+	return ret;
+}
+
+/* wait for all the files handed to the copy engine, false if one failed */
+bool FileIO::waitCopies() {
+	return copyEngine == NULL || copyEngine->wait();
+}
+
+/* copy the content of file from (size bytes expected) to to, using buffer;
+ * on success the times are applied and from is removed with --move */
+FileIO::Status FileIO::transfer(const char *from, const char *to, bool create,
+                                long size, const FileTimes *times,
+                                char *buffer, size_t bufferSize) {
+	int in, out;
+	long total = 0;
+	bool error = false;
+
+	if ((in = open(from, O_RDONLY)) == -1) {
+		warn("%s: %s", from, strerror(errno));
+		return Error;
+	}
+	if ((out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1) {
+		warn("%s: %s", to, strerror(errno));
+		::close(in);
+		return Error;
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#ifdef HAVE_FALLOCATE
+	/* allocate the whole file at once, only a hint */
+	if (size > 0 && fallocate(out, 0, 0, size) != 0)
+		size = 0;
+#endif
+
+	while (!error) {
+		ssize_t icnt = read(in, buffer, bufferSize), ocnt = 0;
+		if (icnt == 0)
+			break;
+		if (icnt < 0 && errno == EINTR)
+			continue;
+		if (icnt < 0) {
+			warn("%s: Could not read file", from);
+			error = true;
+		}
+		while (!error && ocnt < icnt) {
+			ssize_t cnt = write(out, buffer + ocnt, icnt - ocnt);
+			if (cnt < 0 && errno != EINTR) {
+				warn("%s: Could not write file", to);
 				error = true;
-			} else {
-				ocnt = 0;
-				while (ocnt < icnt) {
-					ocnt += outFile.write(buf, icnt - ocnt);
-					if (outFile.error()) {
-						warn("%s: Could not write file", to);
-						error = true;
-						break;
-					}
-				}
+			} else if (cnt > 0) {
+				ocnt += cnt;
 			}
 		}
+		total += ocnt;
+	}
 
-		delete [] buf;
+	/* the file has shrunk since it was preallocated */
+	if (!error && total < size && ftruncate(out, total) != 0) {
+		warn("%s: Could not write file", to);
+		error = true;
+	}
+	::close(in);
+	if (::close(out) != 0 && !error) {
+		warn("%s: Could not write file", to);
+		error = true;
+	}
 
-		inFile.close();
-		outFile.close();
+	if (error) {
+		if (create && FileIO::exists(to))
+			FileIO::remove(to);
+		return Error;
+	}
 
-		if (!error) {
-			if (Options::moveFiles)
-				FileIO::remove(from);
-		} else {
-			if (create && FileIO::exists(to))
-				FileIO::remove(to);
+	if (times != NULL)
+		FileIO::resetTimes(to, *times);
+	if (Options::moveFiles)
+		FileIO::remove(from);
+	else if (times != NULL)
+		/* reading the file has changed its access time */
+		FileIO::resetTimes(from, *times);
+
+	return Success;
+}
+
+FileIO::Status FileIO::link(const char *from, const char *to) {
+	if (::link(from, to)) {
+		if (errno != EXDEV && errno != EPERM && errno != EMLINK)
+			warn("%s: %s", to, strerror(errno));
+		return Error;
+	} else {
+		return Success;
+	}
+}
+
+/* create a hardlink (or a symlink with --symlink) to file from at to,
+ * replacing an existing file atomically; returns Abort if the file has to
+ * be copied instead */
+FileIO::Status FileIO::makeLink(const char *from, const char *to,
+                                bool replace) {
+	string source(from), path(to);
+	int ret;
+
+	if (Options::symlinkFiles && from[0] != '/') {
+		/* the link has to work from its own directory */
+		char *absolute = realpath(from, NULL);
+		if (absolute == NULL) {
+			warn("%s: %s", from, strerror(errno));
 			return Error;
 		}
+		source = absolute;
+		free(absolute);
+	}
+	if (replace) {
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".id3ted-%d", (int) getpid());
+		path += suffix;
+	}
+
+	if (Options::symlinkFiles)
+		ret = symlink(source.c_str(), path.c_str());
+	else
+		ret = ::link(from, path.c_str());
+
+	if (ret != 0) {
+		if (!Options::symlinkFiles &&
+				(errno == EXDEV || errno == EPERM || errno == EMLINK))
+			return Abort;
+		warn("%s: %s", path.c_str(), strerror(errno));
+		return Error;
+	}
+	if (replace && rename(path.c_str(), to) != 0) {
+		warn("%s: Could not rename file to: %s", path.c_str(), to);
+		unlink(path.c_str());
+		return Error;
 	}
 
 	return Success;
 }
 
+/* copy length bytes of file from, starting at offset, to the new file to,
+ * letting the kernel do the copying where possible */
+FileIO::Status FileIO::copyRange(const char *from, long offset, long length,
+                                 const char *to) {
+	int in, out;
+	bool error = false;
+
+	if ((in = open(from, O_RDONLY)) == -1) {
+		warn("%s: %s", from, strerror(errno));
+		return Error;
+	}
+	if ((out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1) {
+		warn("%s: %s", to, strerror(errno));
+		::close(in);
+		return Error;
+	}
+
+#ifdef HAVE_COPY_FILE_RANGE
+	loff_t inOffset = offset;
+	while (length > 0) {
+		ssize_t cnt = copy_file_range(in, &inOffset, out, NULL, length, 0);
+		if (cnt <= 0)
+			// not supported, e.g. across filesystems on older kernels
+			break;
+		length -= cnt;
+	}
+	offset = inOffset;
+#endif
+
+	if (length > 0) {
+		char *buf = new char[FILECPY_BUFSIZE];
+
+		while (length > 0 && !error) {
+			size_t blockSize = length < FILECPY_BUFSIZE ? length : FILECPY_BUFSIZE;
+			ssize_t icnt = pread(in, buf, blockSize, offset), ocnt = 0;
+			if (icnt <= 0) {
+				warn("%s: Could not read file", from);
+				error = true;
+			}
+			while (!error && ocnt < icnt) {
+				ssize_t cnt = write(out, buf + ocnt, icnt - ocnt);
+				if (cnt < 0) {
+					warn("%s: Could not write file", to);
+					error = true;
+				} else {
+					ocnt += cnt;
+				}
+			}
+			offset += icnt;
+			length -= icnt;
+		}
+		delete [] buf;
+	}
+
+	::close(in);
+	if (::close(out) != 0 && !error) {
+		warn("%s: Could not write file", to);
+		error = true;
+	}
+	if (error)
+		FileIO::remove(to);
+
+	return error ? Error : Success;
+}
+
 FileIO::Status FileIO::remove(const char *path) {
 	if (unlink(path)) {
 		warn("%s: %s", path, strerror(errno));
@@ -21,11 +21,14 @@
 
 #include <cstdio>
 #include <sys/time.h>
+#include <sys/types.h>
 
 #include <taglib/tbytevector.h>
 
 #include "id3ted.h"
 
+class CopyEngine;
+
 typedef struct {
 	struct timeval access;
 	struct timeval modification;
@@ -39,19 +42,34 @@ class FileIO {
 			Error
 		};
 
+		enum Overwrite {
+			Ask = 0,
+			Never,
+			Always
+		};
+
 		static bool exists(const char*);
 		static bool isRegular(const char*);
 		static bool isReadable(const char*);
 		static bool isWritable(const char*);
-		static string sizeHumanReadable(unsigned long);
+		static long size(const char*);
 		static const char* mimetype(const char*);
 		static Status saveTimes(const char*, FileTimes&);
 		static Status resetTimes(const char*, const FileTimes&);
 		static Status createDir(const char*);
+		static Status createDir(const char*, dev_t&);
 		static bool confirmOverwrite(const char*);
-		static Status copy(const char*, const char*);
+		static Status copy(const char*, const char*, Overwrite,
+		                   const FileTimes* = NULL);
+		static bool waitCopies();
+		static Status transfer(const char*, const char*, bool, long,
+		                       const FileTimes*, char*, size_t);
+		static Status link(const char*, const char*);
+		static Status copyRange(const char*, long, long, const char*);
 		static Status remove(const char*);
 
+		static CopyEngine *copyEngine;
+
 		FileIO(const char*, const char*);
 		virtual ~FileIO() = 0;
 
@@ -63,6 +81,8 @@ class FileIO {
 		Status seek(long);
 
 	protected:
+		static Status makeLink(const char*, const char*, bool);
+
 		FILE *stream;
 		const char *path;
 		const char *mode;
@@ -79,7 +99,8 @@ class IFile : public FileIO {
 
 class OFile : public FileIO {
 	public:
-		OFile(const char *_path) : FileIO(_path, "w+") {}
+		OFile(const char *_path, bool append = false) :
+				FileIO(_path, append ? "a" : "w+") {}
 		~OFile() { if (stream) close(); }
 
 		size_t write(const char*, size_t);
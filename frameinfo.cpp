@@ -19,13 +19,20 @@
 #include <cstring>
 #include <cstdio>
 
+#include <taglib/attachedpictureframe.h>
+#include <taglib/commentsframe.h>
+#include <taglib/textidentificationframe.h>
+#include <taglib/unsynchronizedlyricsframe.h>
+#include <taglib/urllinkframe.h>
+
 #include "fileio.h"
 #include "frameinfo.h"
+#include "hash.h"
 #include "options.h"
 
 FrameInfo::FrameInfo(const char *id, ID3v2FrameID fid, const char *text) :
 		_id(id), _fid(fid), _text(text, DEF_TSTR_ENC),
-		_description(), _language("XXX"), _data()
+		_description(), _language("XXX"), _data(), _hash(0)
 {
 	switch (_fid) {
 		case FID3_APIC: {
@@ -41,10 +48,12 @@ FrameInfo::FrameInfo(const char *id, ID3v2FrameID fid, const char *text) :
 				break;
 			}
 			file.read(_data);
-			if (file.error())
+			if (file.error()) {
 				_data.clear();
-			else
+			} else {
 				_description = mimetype;
+				_hash = Hash::of(_data);
+			}
 			break;
 		}
 		case FID3_COMM:
@@ -60,6 +69,70 @@ FrameInfo::FrameInfo(const char *id, ID3v2FrameID fid, const char *text) :
 	}
 }
 
+/* create a new frame holding the information, the caller takes ownership;
+ * returns NULL, if there is nothing to add (empty text means removal) */
+ID3v2::Frame* FrameInfo::createFrame() const {
+	if (_text.isEmpty() && _fid != FID3_APIC)
+		return NULL;
+
+	switch (_fid) {
+		case FID3_APIC: {
+			ID3v2::AttachedPictureFrame *apic = new ID3v2::AttachedPictureFrame();
+			apic->setMimeType(_description);
+			apic->setType(ID3v2::AttachedPictureFrame::FrontCover);
+			apic->setPicture(_data);
+			return apic;
+		}
+		case FID3_COMM: {
+			ID3v2::CommentsFrame *comment = new ID3v2::CommentsFrame(DEF_TSTR_ENC);
+			comment->setText(_text);
+			comment->setDescription(_description);
+			comment->setLanguage(_language);
+			return comment;
+		}
+		case FID3_TXXX: {
+			ID3v2::UserTextIdentificationFrame *userText =
+					new ID3v2::UserTextIdentificationFrame(DEF_TSTR_ENC);
+			userText->setText(_text);
+			userText->setDescription(_description);
+			return userText;
+		}
+		case FID3_USLT: {
+			ID3v2::UnsynchronizedLyricsFrame *lyrics =
+					new ID3v2::UnsynchronizedLyricsFrame(DEF_TSTR_ENC);
+			lyrics->setText(_text);
+			lyrics->setDescription(_description);
+			lyrics->setLanguage(_language);
+			return lyrics;
+		}
+		case FID3_WCOM:
+		case FID3_WCOP:
+		case FID3_WOAF:
+		case FID3_WOAR:
+		case FID3_WOAS:
+		case FID3_WORS:
+		case FID3_WPAY:
+		case FID3_WPUB: {
+			ID3v2::UrlLinkFrame *urlLink = new ID3v2::UrlLinkFrame(_id);
+			urlLink->setUrl(_text);
+			return urlLink;
+		}
+		case FID3_WXXX: {
+			ID3v2::UserUrlLinkFrame *userUrl =
+					new ID3v2::UserUrlLinkFrame(DEF_TSTR_ENC);
+			userUrl->setUrl(_text);
+			userUrl->setDescription(_description);
+			return userUrl;
+		}
+		default: {
+			ID3v2::TextIdentificationFrame *textFrame =
+					new ID3v2::TextIdentificationFrame(_id, DEF_TSTR_ENC);
+			textFrame->setText(_text);
+			return textFrame;
+		}
+	}
+}
+
 void FrameInfo::split2() {
 	int idx, len;
 
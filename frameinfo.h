@@ -19,7 +19,10 @@
 #ifndef FRAMEINFO_H
 #define FRAMEINFO_H
 
+#include <stdint.h>
+
 #include <taglib/tbytevector.h>
+#include <taglib/id3v2frame.h>
 
 #include "id3ted.h"
 
@@ -33,6 +36,9 @@ class FrameInfo {
 		const String& description() const { return _description; }
 		const ByteVector& language() const { return _language; }
 		const ByteVector& data() const { return _data; }
+		uint64_t hash() const { return _hash; }
+
+		ID3v2::Frame* createFrame() const;
 
 	private:
 		const char *_id;
@@ -41,6 +47,7 @@ class FrameInfo {
 		String _description;
 		ByteVector _language;
 		ByteVector _data;
+		uint64_t _hash;
 
 		void split2();
 		void split3();
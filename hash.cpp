@@ -0,0 +1,167 @@
+/* id3ted: hash.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+
+#include "hash.h"
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const char *p) {
+	const unsigned char *b = (const unsigned char*) p;
+
+	return (uint64_t) b[0]       | (uint64_t) b[1] << 8  |
+	       (uint64_t) b[2] << 16 | (uint64_t) b[3] << 24 |
+	       (uint64_t) b[4] << 32 | (uint64_t) b[5] << 40 |
+	       (uint64_t) b[6] << 48 | (uint64_t) b[7] << 56;
+}
+
+static inline uint32_t read32(const char *p) {
+	const unsigned char *b = (const unsigned char*) p;
+
+	return (uint32_t) b[0]       | (uint32_t) b[1] << 8 |
+	       (uint32_t) b[2] << 16 | (uint32_t) b[3] << 24;
+}
+
+static inline uint64_t xxRound(uint64_t acc, uint64_t input) {
+	acc += input * PRIME2;
+	acc = rotl(acc, 31);
+	return acc * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+	acc ^= xxRound(0, val);
+	return acc * PRIME1 + PRIME4;
+}
+
+Hash::Hash() : bufferSize(0), totalSize(0) {
+	acc[0] = PRIME1 + PRIME2;
+	acc[1] = PRIME2;
+	acc[2] = 0;
+	acc[3] = -PRIME1;
+}
+
+void Hash::update(const char *data, size_t size) {
+	const char *end = data + size;
+
+	totalSize += size;
+
+	if (bufferSize + size < 32) {
+		memcpy(buffer + bufferSize, data, size);
+		bufferSize += size;
+		return;
+	}
+
+	if (bufferSize > 0) {
+		memcpy(buffer + bufferSize, data, 32 - bufferSize);
+		data += 32 - bufferSize;
+		for (int i = 0; i < 4; ++i)
+			acc[i] = xxRound(acc[i], read64(buffer + 8 * i));
+		bufferSize = 0;
+	}
+
+	for (; data + 32 <= end; data += 32) {
+		acc[0] = xxRound(acc[0], read64(data));
+		acc[1] = xxRound(acc[1], read64(data + 8));
+		acc[2] = xxRound(acc[2], read64(data + 16));
+		acc[3] = xxRound(acc[3], read64(data + 24));
+	}
+
+	if (data < end) {
+		bufferSize = end - data;
+		memcpy(buffer, data, bufferSize);
+	}
+}
+
+void Hash::update(const ByteVector &data) {
+	update(data.data(), data.size());
+}
+
+uint64_t Hash::digest() const {
+	const char *p = buffer;
+	const char *end = buffer + bufferSize;
+	uint64_t h;
+
+	if (totalSize >= 32) {
+		h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+		for (int i = 0; i < 4; ++i)
+			h = mergeRound(h, acc[i]);
+	} else {
+		h = acc[2] + PRIME5;
+	}
+	h += totalSize;
+
+	for (; p + 8 <= end; p += 8) {
+		h ^= xxRound(0, read64(p));
+		h = rotl(h, 27) * PRIME1 + PRIME4;
+	}
+	if (p + 4 <= end) {
+		h ^= (uint64_t) read32(p) * PRIME1;
+		h = rotl(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; ++p) {
+		h ^= (uint64_t) (unsigned char) *p * PRIME5;
+		h = rotl(h, 11) * PRIME1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+uint64_t Hash::of(const ByteVector &data) {
+	Hash hash;
+
+	hash.update(data);
+	return hash.digest();
+}
+
+/* hash length bytes of file, starting at offset, blockwise */
+bool Hash::of(IFile &file, long offset, long length, uint64_t &digest) {
+	Hash hash;
+	char *buffer = new char[FILE_BUF_SIZE];
+	bool error = file.seek(offset) != FileIO::Success;
+
+	while (length > 0 && !error) {
+		size_t blockSize = length < FILE_BUF_SIZE ? length : FILE_BUF_SIZE;
+		if (file.read(buffer, blockSize) != blockSize) {
+			error = true;
+		} else {
+			hash.update(buffer, blockSize);
+			length -= blockSize;
+		}
+	}
+	delete [] buffer;
+
+	if (!error)
+		digest = hash.digest();
+	return !error;
+}
@@ -0,0 +1,54 @@
+/* id3ted: hash.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <stdint.h>
+
+#include <taglib/tbytevector.h>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+/* 64 bit non-cryptographic hash (XXH64), used to compare large chunks of
+ * data like attached pictures without keeping them around.
+ * the data can be fed blockwise with update(), the result does not depend
+ * on the block sizes.
+ *
+ * thanks to Yann Collet! (http://cyan4973.github.io/xxHash/) */
+class Hash {
+	public:
+		Hash();
+
+		void update(const char*, size_t);
+		void update(const ByteVector&);
+		uint64_t digest() const;
+
+		static uint64_t of(const ByteVector&);
+		static bool of(IFile&, long, long, uint64_t&);
+
+	private:
+		uint64_t acc[4];
+		char buffer[32];
+		size_t bufferSize;
+		uint64_t totalSize;
+};
+
+#endif /* HASH_H */
@@ -0,0 +1,321 @@
+/* id3ted: journal.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "journal.h"
+#include "hash.h"
+#include "rawtags.h"
+#include "safewriter.h"
+
+static const char MAGIC[] = "ID3TJRN\1";
+static const uint MAGIC_SIZE = 8;
+
+Journal::~Journal() {
+	if (fd != -1)
+		::close(fd);
+}
+
+/* open the journal at path for appending */
+bool Journal::open(const char *path) {
+	struct stat stats;
+
+	if ((fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0644)) == -1 ||
+			fstat(fd, &stats) != 0) {
+		warn("%s: %s", path, strerror(errno));
+		return false;
+	}
+	if (stats.st_size == 0) {
+		// the new journal has to survive a crash right from the start
+		string dir(path);
+		size_t lastSlash = dir.rfind('/');
+		dir = lastSlash != string::npos ? dir.substr(0, lastSlash + 1) : ".";
+		if (write(fd, MAGIC, MAGIC_SIZE) != MAGIC_SIZE || fsync(fd) != 0) {
+			warn("%s: Could not write file", path);
+			return false;
+		}
+		if (!SafeWriter::syncDirectory(dir))
+			return false;
+	}
+
+	return true;
+}
+
+/* append the current tags and times of file path and sync the journal,
+ * before the file is modified. the file is going to be modified in its
+ * copy work (path itself, if it is modified in place), whose device and
+ * inode are recorded to recognize the file at path later on. */
+bool Journal::record(const char *path, const char *work) {
+	ByteVector data, id3v2, id3v1;
+	long id3v2Size, id3v1Size;
+	struct stat stats;
+	string absolute;
+	int in;
+
+	if ((in = ::open(work, O_RDONLY)) == -1 || fstat(in, &stats) != 0) {
+		warn("%s: %s", work, strerror(errno));
+		if (in != -1)
+			::close(in);
+		return false;
+	}
+	bool success = RawTags::read(in, stats.st_size, &id3v2, id3v2Size, &id3v1,
+	                             id3v1Size);
+	::close(in);
+	if (!success) {
+		warn("%s: Could not read file", path);
+		return false;
+	}
+
+	FileTimes times;
+	if (FileIO::saveTimes(path, times) != FileIO::Success)
+		return false;
+
+	// --rollback may be run from any directory
+	char *resolved = realpath(path, NULL);
+	if (resolved == NULL) {
+		warn("%s: %s", path, strerror(errno));
+		return false;
+	}
+	absolute = resolved;
+	free(resolved);
+
+	data.append(ByteVector::fromUInt(absolute.size()));
+	data.append(ByteVector(absolute.data(), absolute.size()));
+	put(data, stats.st_dev);
+	put(data, stats.st_ino);
+	put(data, stats.st_size);
+	put(data, times.access.tv_sec);
+	data.append(ByteVector::fromUInt(times.access.tv_usec));
+	put(data, times.modification.tv_sec);
+	data.append(ByteVector::fromUInt(times.modification.tv_usec));
+	data.append(ByteVector::fromUInt(id3v2.size()));
+	data.append(id3v2);
+	data.append(ByteVector::fromUInt(id3v1.size()));
+	data.append(id3v1);
+
+	ByteVector entry = ByteVector::fromUInt(data.size());
+	entry.append(data);
+	put(entry, Hash::of(data));
+
+	// a single write, so that a record is either complete or at the end
+	const char *pos = entry.data();
+	size_t left = entry.size();
+	while (left > 0) {
+		ssize_t cnt = write(fd, pos, left);
+		if (cnt < 0 && errno == EINTR)
+			continue;
+		if (cnt <= 0) {
+			warn("Could not write journal: %s", strerror(errno));
+			return false;
+		}
+		pos += cnt;
+		left -= cnt;
+	}
+	if (fdatasync(fd) != 0) {
+		warn("Could not write journal: %s", strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+/* make sure the journal is on disk */
+bool Journal::close() {
+	bool success = fd == -1 || (fsync(fd) == 0 && ::close(fd) == 0);
+
+	fd = -1;
+	if (!success)
+		warn("Could not write journal: %s", strerror(errno));
+	return success;
+}
+
+/* restore the tags and times of all the files in the journal at path,
+ * using the given number of threads. the first record of every file is
+ * used, i.e. the state before the first of several runs. */
+bool Journal::rollback(const char *path, uint threadCount) {
+	vector<Entry> entries;
+	vector<pthread_t> threads;
+	Rollback state;
+
+	if (!read(path, entries))
+		return false;
+
+	state.entries = &entries;
+	state.next = 0;
+	state.success = true;
+	pthread_mutex_init(&state.mutex, NULL);
+
+	for (uint i = 1; i < threadCount && i < entries.size(); ++i) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, work, &state) != 0)
+			break;
+		threads.push_back(thread);
+	}
+	work(&state);
+	for (uint i = 0; i < threads.size(); ++i)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&state.mutex);
+
+	return state.success;
+}
+
+void* Journal::work(void *arg) {
+	Rollback *state = (Rollback*) arg;
+
+	while (true) {
+		pthread_mutex_lock(&state->mutex);
+		uint i = state->next++;
+		pthread_mutex_unlock(&state->mutex);
+		if (i >= state->entries->size())
+			break;
+
+		if (!restore((*state->entries)[i])) {
+			pthread_mutex_lock(&state->mutex);
+			state->success = false;
+			pthread_mutex_unlock(&state->mutex);
+		}
+	}
+
+	return NULL;
+}
+
+bool Journal::read(const char *path, vector<Entry> &entries) {
+	map<string, bool> seen;
+	ByteVector journal;
+	IFile file(path);
+
+	if (!file.isOpen())
+		return false;
+	file.read(journal);
+	if (file.error() || !journal.startsWith(ByteVector(MAGIC, MAGIC_SIZE))) {
+		warn("%s: Not an id3ted journal", path);
+		return false;
+	}
+
+	uint pos = MAGIC_SIZE;
+	while (pos < journal.size()) {
+		if (journal.size() - pos < 4 || journal.size() - pos - 4 <
+				(uint64_t) journal.mid(pos, 4).toUInt() + 8) {
+			warn("%s: Incomplete last record ignored", path);
+			break;
+		}
+		uint length = journal.mid(pos, 4).toUInt();
+		ByteVector data = journal.mid(pos + 4, length);
+		uint end = pos + 4 + length;
+		if (get(journal, end, 8) != Hash::of(data)) {
+			warn("%s: Corrupt record ignored", path);
+			break;
+		}
+		pos = end;
+
+		Entry entry;
+		uint field = 0, size;
+		bool valid = true;
+
+		size = get(data, field, 4);
+		valid = size <= data.size() - field;
+		if (valid) {
+			entry.path = string(data.mid(field, size).data(), size);
+			field += size;
+			valid = data.size() - field >= 3 * 8 + 2 * 12 + 4;
+		}
+		if (valid) {
+			entry.device = get(data, field, 8);
+			entry.inode = get(data, field, 8);
+			entry.size = get(data, field, 8);
+			entry.times.access.tv_sec = get(data, field, 8);
+			entry.times.access.tv_usec = get(data, field, 4);
+			entry.times.modification.tv_sec = get(data, field, 8);
+			entry.times.modification.tv_usec = get(data, field, 4);
+			size = get(data, field, 4);
+			valid = size <= data.size() - field;
+		}
+		if (valid) {
+			entry.id3v2 = data.mid(field, size);
+			field += size;
+			valid = data.size() - field >= 4;
+		}
+		if (valid) {
+			size = get(data, field, 4);
+			valid = size == data.size() - field;
+		}
+		if (!valid) {
+			warn("%s: Corrupt record ignored", path);
+			break;
+		}
+		entry.id3v1 = data.mid(field, size);
+
+		if (!seen[entry.path]) {
+			seen[entry.path] = true;
+			entries.push_back(entry);
+		}
+	}
+
+	return true;
+}
+
+/* put the tags of entry back into its file */
+bool Journal::restore(const Entry &entry) {
+	const char *path = entry.path.c_str();
+	long audioSize = entry.size - entry.id3v2.size() - entry.id3v1.size();
+	struct stat stats;
+
+	if (stat(path, &stats) != 0) {
+		warn("%s: %s", path, strerror(errno));
+		return false;
+	}
+	if ((uint64_t) stats.st_dev != entry.device ||
+			(uint64_t) stats.st_ino != entry.inode) {
+		warn("%s: Not rolled back, because it is not the journaled file", path);
+		return false;
+	}
+
+	FileIO::Status ret = RawTags::replace(path, entry.id3v2, entry.id3v1,
+	                                      audioSize);
+	if (ret == FileIO::Abort)
+		warn("%s: Not rolled back, because its audio data has changed", path);
+	if (ret != FileIO::Success)
+		return false;
+
+	FileIO::resetTimes(path, entry.times);
+	return true;
+}
+
+void Journal::put(ByteVector &data, uint64_t value) {
+	data.append(ByteVector::fromUInt(value >> 32));
+	data.append(ByteVector::fromUInt(value & 0xFFFFFFFF));
+}
+
+/* the big-endian number of the given size at pos in data, pos is advanced */
+uint64_t Journal::get(const ByteVector &data, uint &pos, uint size) {
+	uint64_t value = 0;
+
+	for (uint i = 0; i < size; ++i)
+		value = value << 8 | (unsigned char) data[pos + i];
+	pos += size;
+
+	return value;
+}
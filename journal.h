@@ -0,0 +1,88 @@
+/* id3ted: journal.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <taglib/tbytevector.h>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+/* undo journal for --journal/--rollback: before a file is modified, its
+ * original tags and times are appended to the journal, so that they can be
+ * restored later without a backup of the audio data.
+ *
+ * format: "ID3TJRN\1", followed by records of
+ *   uint32 length, <length bytes of data>, uint64 hash of the data
+ * and the data of a record consists of
+ *   uint32 length, absolute path
+ *   uint64 device, uint64 inode (of the file after the modification),
+ *   uint64 size of the file
+ *   uint64 seconds, uint32 microseconds of the access time,
+ *   uint64 seconds, uint32 microseconds of the modification time,
+ *   uint32 length, id3v2 tag at the beginning of the file (incl. header)
+ *   uint32 length, id3v1 tag at the end of the file
+ * all numbers are big-endian. an incomplete last record (e.g. after a
+ * crash) is ignored. */
+class Journal {
+	public:
+		Journal() : fd(-1) {}
+		~Journal();
+
+		bool open(const char*);
+		bool record(const char*, const char*);
+		bool close();
+
+		static bool rollback(const char*, uint);
+
+	private:
+		typedef struct {
+			string path;
+			uint64_t device;
+			uint64_t inode;
+			uint64_t size;
+			FileTimes times;
+			ByteVector id3v2;
+			ByteVector id3v1;
+		} Entry;
+
+		typedef struct {
+			const vector<Entry> *entries;
+			uint next;
+			bool success;
+			pthread_mutex_t mutex;
+		} Rollback;
+
+		int fd;
+
+		static bool read(const char*, vector<Entry>&);
+		static bool restore(const Entry&);
+		static void* work(void*);
+
+		static void put(ByteVector&, uint64_t);
+		static uint64_t get(const ByteVector&, uint&, uint);
+};
+
+#endif /* JOURNAL_H */
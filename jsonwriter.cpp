@@ -0,0 +1,167 @@
+/* id3ted: jsonwriter.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cmath>
+
+#include "jsonwriter.h"
+
+JsonWriter::JsonWriter(Writer &_out) :
+		out(_out), filter(NULL), depth(0), afterKey(false) {}
+
+void JsonWriter::beginObject() {
+	separate();
+	out << '{';
+	if (depth < MAX_DEPTH)
+		first[depth] = true;
+	++depth;
+}
+
+void JsonWriter::endObject() {
+	out << '}';
+	--depth;
+	endValue();
+}
+
+void JsonWriter::beginArray() {
+	separate();
+	out << '[';
+	if (depth < MAX_DEPTH)
+		first[depth] = true;
+	++depth;
+}
+
+void JsonWriter::endArray() {
+	out << ']';
+	--depth;
+	endValue();
+}
+
+void JsonWriter::key(const char *name) {
+	separate();
+	putString(name);
+	out << ':';
+	afterKey = true;
+}
+
+/* write the key, if the field is not filtered out; the value has to be
+ * written only if this returns true */
+bool JsonWriter::field(const char *name) {
+	if (filter != NULL && !filter->contains(name))
+		return false;
+
+	key(name);
+	return true;
+}
+
+void JsonWriter::value(const char *text) {
+	separate();
+	putString(text);
+	endValue();
+}
+
+void JsonWriter::value(const String &text) {
+	value(text.toCString(USE_UTF8));
+}
+
+void JsonWriter::value(long number) {
+	separate();
+	out << number;
+	endValue();
+}
+
+void JsonWriter::value(double number) {
+	char tmp[32];
+
+	// json has no representation for nan and infinity
+	if (!isfinite(number)) {
+		null();
+		return;
+	}
+
+	separate();
+	out.write(tmp, snprintf(tmp, sizeof(tmp), "%.6g", number));
+	endValue();
+}
+
+void JsonWriter::value(bool flag) {
+	separate();
+	out << (flag ? "true" : "false");
+	endValue();
+}
+
+void JsonWriter::null() {
+	separate();
+	out << "null";
+	endValue();
+}
+
+/* put a comma in front of every value of an object or array but the
+ * first one; values directly following a key need no separator */
+void JsonWriter::separate() {
+	if (afterKey) {
+		afterKey = false;
+	} else if (depth > 0 && depth <= MAX_DEPTH) {
+		if (!first[depth-1])
+			out << ',';
+		first[depth-1] = false;
+	}
+}
+
+void JsonWriter::endValue() {
+	if (depth == 0)
+		out << '\n';
+}
+
+void JsonWriter::putString(const char *text) {
+	static const char hexDigits[] = "0123456789abcdef";
+	const char *plain = text;
+
+	out << '"';
+	for (; *text != '\0'; ++text) {
+		unsigned char c = *text;
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		// write the run of characters not needing any escaping at once
+		out.write(plain, text - plain);
+		plain = text + 1;
+		out << '\\';
+		switch (c) {
+			case '"':
+			case '\\':
+				out << (char) c;
+				break;
+			case '\n':
+				out << 'n';
+				break;
+			case '\r':
+				out << 'r';
+				break;
+			case '\t':
+				out << 't';
+				break;
+			default:
+				out << "u00";
+				out << hexDigits[c >> 4];
+				out << hexDigits[c & 0x0F];
+				break;
+		}
+	}
+	out.write(plain, text - plain);
+	out << '"';
+}
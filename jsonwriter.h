@@ -0,0 +1,63 @@
+/* id3ted: jsonwriter.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include "id3ted.h"
+#include "fieldlist.h"
+#include "writer.h"
+
+/* streaming writer for newline delimited json: every top-level value
+ * ends with a newline. nesting is limited to MAX_DEPTH levels. */
+class JsonWriter {
+	public:
+		explicit JsonWriter(Writer&);
+
+		void setFilter(const FieldList *_filter) { filter = _filter; }
+
+		void beginObject();
+		void endObject();
+		void beginArray();
+		void endArray();
+		void key(const char*);
+		bool field(const char*);
+
+		void value(const char*);
+		void value(const String&);
+		void value(int number) { value((long) number); }
+		void value(long);
+		void value(double);
+		void value(bool);
+		void null();
+
+	private:
+		enum { MAX_DEPTH = 16 };
+
+		Writer &out;
+		const FieldList *filter;
+		int depth;
+		bool first[MAX_DEPTH];
+		bool afterKey;
+
+		void separate();
+		void putString(const char*);
+		void endValue();
+};
+
+#endif /* JSONWRITER_H */
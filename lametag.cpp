@@ -26,11 +26,10 @@
 
 #include <cstdlib>
 #include <cstdio>
-#include <iostream>
-#include <sstream>
 
 #include "lametag.h"
 #include "fileio.h"
+#include "writer.h"
 
 unsigned short LameTag::crc16Table[] = {
 	0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241,
@@ -133,218 +132,292 @@ LameTag::LameTag(const char *_filename, long _frameOffset, long _frameLength) :
 }
 
 void LameTag::print(bool checkCRC) {
+	Writer &out = Writer::out;
+	unsigned long start;
+
 	if (!valid)
 		return;
 
-	ostringstream tmp;
-	tmp.setf(ios::fixed);
-	tmp.precision(1);
+	out << encoder << " tag (revision " << tagRevision << "):\n";
 
-	cout << encoder << " tag (revision " << tagRevision << "):" << endl;
+	out.putPadded("encoding method", 16) << ": ";
+	out.putPadded(encodingMethodName(encodingMethod), 15);
 
-	printf("%-16s: ", "encoding method");
-	switch (encodingMethod) {
-		case 8:
-			tmp << "2-pass ";
-		case 1:
-			tmp << "CBR";
-			break;
-		case 9:
-			tmp << "2-pass ";
-		case 2:
-			tmp << "ABR";
-			break;
-		case 3:
-		case 4:
-		case 5:
-		case 6:
-			if      (encodingMethod == 3) tmp << "old/re ";
-			else if (encodingMethod == 4) tmp << "new/mtrh ";
-			else if (encodingMethod == 5) tmp << "new/mt ";
-			tmp << "VBR";
-			break;
-		default:
-			tmp << "unknown";
-			break;
-	}
-	printf("%-15s", tmp.str().c_str());
-	tmp.str("");
-
-	printf("%-15s: ", "quality");
+	out.putPadded("quality", 15) << ": ";
 	if (quality > 0 && quality <= 100)
-		printf("V%d/q%d", (100 - quality) / 10, (100 - quality) % 10);
+		out << 'V' << (100 - quality) / 10 << "/q" << (100 - quality) % 10;
 	else
-		cout << "unknown";
-	cout << endl;
+		out << "unknown";
+	out << '\n';
 
-	printf("%-16s: ", "stereo mode");
-	switch (stereoMode) {
-		case 0:
-			tmp << "mono";
-			break;
-		case 1:
-			tmp << "stereo";
-			break;
-		case 2:
-			tmp << "dual";
-			break;
-		case 3:
-			tmp << "joint";
-			break;
-		case 4:
-			tmp << "force";
-			break;
-		case 5:
-			tmp << "auto";
-			break;
-		case 6:
-			tmp << "intensity";
-			break;
-		default:
-			tmp << "undefined";
-			break;
-	}
-	printf("%-15s", tmp.str().c_str());
-	tmp.str("");
+	out.putPadded("stereo mode", 16) << ": ";
+	out.putPadded(stereoModeName(stereoMode), 15);
 
-	printf("%-15s: ", "source rate");
-	switch (sourceRate) {
-		case 0:
-			cout << "<= 32";
-			break;
-		case 1:
-			cout << "44.1";
-			break;
-		case 2:
-			cout << "48";
-			break;
-		default:
-			cout << "> 48";
-			break;
-	}
-	cout << " kHz" << endl;
+	out.putPadded("source rate", 15) << ": ";
+	out << sourceRateName(sourceRate) << " kHz\n";
 
+	start = out.position();
 	if (encodingMethod == 2 || encodingMethod == 9)
-		tmp << "average ";
+		out << "average ";
 	else if (encodingMethod > 2 && encodingMethod < 7)
-		tmp << "minimal ";
-	tmp << "bitrate";
-	printf("%-16s: ", tmp.str().c_str());
-	tmp.str("");
+		out << "minimal ";
+	out << "bitrate";
+	out.pad(start, 16) << ": ";
+	start = out.position();
 	if (bitrate == 0xFF)
-		tmp << ">= ";
-	tmp << bitrate << " kBit/s";
-	printf("%-15s", tmp.str().c_str());
-	tmp.str("");
-
-	printf("%-15s: ", "music length");
-	cout << FileIO::sizeHumanReadable(musicLength) << endl;
-
-	printf("%-16s: ", "lowpass");
-	if (lowpassFilter == 0) {
-		tmp << "unknown";
-	} else {
-		tmp << lowpassFilter << "00 Hz";
-	}
-	printf("%-15s", tmp.str().c_str());
-	tmp.str("");
+		out << ">= ";
+	out << bitrate << " kBit/s";
+	out.pad(start, 15);
+
+	out.putPadded("music length", 15) << ": ";
+	out.putSize(musicLength) << '\n';
 
-	printf("%-15s: ", "mp3gain");
+	out.putPadded("lowpass", 16) << ": ";
+	start = out.position();
+	if (lowpassFilter == 0)
+		out << "unknown";
+	else
+		out << lowpassFilter << "00 Hz";
+	out.pad(start, 15);
+
+	out.putPadded("mp3gain", 15) << ": ";
 	if (mp3Gain != 0.0)
-		printf("%+.f dB", mp3Gain);
+		out.putFixed(mp3Gain, 0, true) << " dB\n";
 	else
-		cout << "none" << endl;
+		out << "none\n";
 
-	printf("%-16s: ", "ATH type");
-	tmp << athType;
-	printf("%-15s", tmp.str().c_str());
-	tmp.str("");
+	out.putPadded("ATH type", 16) << ": ";
+	start = out.position();
+	out << athType;
+	out.pad(start, 15);
 
-	printf("%-15s: ", "encoding flags");
+	out.putPadded("encoding flags", 15) << ": ";
 	bool flag = false;
 	if (encodingFlags & 0x10) {
-		cout << "nspsytune ";
+		out << "nspsytune ";
 		flag = true;
 	}
 	if (encodingFlags & 0x20) {
-		cout << "nssafejoint ";
+		out << "nssafejoint ";
 		flag = true;
 	}
 	if (encodingFlags & 0xC0) {
-		cout << "nogap";
+		out << "nogap";
 		flag = true;
 		if (encodingFlags & 0x80)
-			cout << "<";
+			out << "<";
 		if (encodingFlags & 0x40)
-			cout << ">";
+			out << ">";
 	}
 	if (!flag)
-		cout << "none";
-	cout << endl;
+		out << "none";
+	out << '\n';
+
+	out.putPadded("encoding delay", 16) << ": ";
+	start = out.position();
+	out << encodingDelay << " samples";
+	out.pad(start, 15);
+
+	out.putPadded("padding", 15) << ": ";
+	out << padding << " samples\n";
+
+	out.putPadded("noise shaping", 16) << ": ";
+	start = out.position();
+	out << noiseShaping;
+	out.pad(start, 15);
+
+	out.putPadded("unwise settings", 15) << ": ";
+	out << (unwiseSettings ? "yes" : "no") << '\n';
+
+	out.putPadded("info tag CRC", 16) << ": ";
+	out.putHex(tagCRC, 4) << ' ';
+	start = out.position();
+	if (checkCRC)
+		out << "(" << (checkTagCRC() ? "correct" : "invalid") << ")";
+	out.pad(start, 10);
+
+	out.putPadded("music CRC", 15) << ": ";
+	out.putHex(musicCRC, 4);
+	if (checkCRC) {
+		bool correct;
+		if (!checkMusicCRC(correct))
+			return;
+		out << " (" << (correct ? "correct" : "invalid") << ")";
+	}
+	out << '\n';
+
+	out.putPadded("ReplayGain: peak", 16) << ": ";
+	out << (int) peakSignal * 100 << '\n';
+
+	out.putPadded("track gain", 16) << ": ";
+	start = out.position();
+	if (trackGain > 0.0)
+		out << '+';
+	out.putFixed(trackGain, 1) << " dB";
+	out.pad(start, 15);
+
+	out.putPadded("album gain", 15) << ": ";
+	if (albumGain > 0.0)
+		out << '+';
+	out.putFixed(albumGain, 1) << " dB\n";
+}
 
-	printf("%-16s: ", "encoding delay");
-	tmp << encodingDelay << " samples";
-	printf("%-15s", tmp.str().c_str());
-	tmp.str("");
+void LameTag::write(JsonWriter &json, bool checkCRC) {
+	if (!valid)
+		return;
 
-	printf("%-15s: ", "padding");
-	cout << padding << " samples" << endl;
+	json.beginObject();
+	if (json.field("encoder"))
+		json.value(encoder);
+	if (json.field("revision"))
+		json.value(tagRevision);
+	if (json.field("encoding_method"))
+		json.value(encodingMethodName(encodingMethod));
+	if (json.field("quality")) {
+		if (quality > 0 && quality <= 100)
+			json.value(quality);
+		else
+			json.null();
+	}
+	if (json.field("stereo_mode"))
+		json.value(stereoModeName(stereoMode));
+	if (json.field("source_rate"))
+		json.value(sourceRateName(sourceRate));
+	if (json.field("bitrate"))
+		json.value((int) bitrate);
+	if (json.field("music_length"))
+		json.value((long) musicLength);
+	if (json.field("lowpass"))
+		json.value(lowpassFilter * 100);
+	if (json.field("mp3gain"))
+		json.value((double) mp3Gain);
+	if (json.field("ath_type"))
+		json.value(athType);
+	if (json.field("encoding_flags"))
+		json.value(encodingFlags);
+	if (json.field("encoding_delay"))
+		json.value(encodingDelay);
+	if (json.field("padding"))
+		json.value(padding);
+	if (json.field("noise_shaping"))
+		json.value(noiseShaping);
+	if (json.field("unwise_settings"))
+		json.value(unwiseSettings);
+	if (json.field("tag_crc"))
+		json.value((int) tagCRC);
+	if (checkCRC && json.field("tag_crc_correct"))
+		json.value(checkTagCRC());
+	if (json.field("music_crc"))
+		json.value((int) musicCRC);
+	if (checkCRC && json.field("music_crc_correct")) {
+		bool correct;
+		if (checkMusicCRC(correct))
+			json.value(correct);
+		else
+			json.null();
+	}
+	if (json.field("peak_signal"))
+		json.value((double) peakSignal);
+	if (json.field("track_gain"))
+		json.value(trackGain);
+	if (json.field("album_gain"))
+		json.value(albumGain);
+	json.endObject();
+}
 
-	printf("%-16s: ", "noise shaping");
-	tmp << noiseShaping;
-	printf("%-15s", tmp.str().c_str());
-	tmp.str("");
+bool LameTag::checkTagCRC() {
+	int size = frameLength < 190 ? frameLength : 190;
+	unsigned short crc = 0;
 
-	printf("%-15s: ", "unwise settings");
-	cout << (unwiseSettings ? "yes" : "no") << endl;
+	crc16Checksum(&crc, frame.data(), size);
 
-	printf("%-16s: %04X ", "info tag CRC", tagCRC);
-	if (checkCRC) {
-		int size = frameLength < 190 ? frameLength : 190;
-		unsigned short crc = 0;
-		crc16Checksum(&crc, frame.data(), size);
-		tmp << "(" << (crc != tagCRC ? "invalid" : "correct") << ")";
-	}
-	printf("%-10s", tmp.str().c_str());
-	tmp.str("");
+	return crc == tagCRC;
+}
 
-	printf("%-15s: %04X", "music CRC", musicCRC);
-	if (checkCRC) {
-		unsigned short crc = 0;
-		size_t size = musicLength - frameLength;
-		char *buffer = new char[FILE_BUF_SIZE];
-		IFile file(filename);
-
-		file.seek(frameOffset + frameLength);
-		while (size > 0 && !file.eof() && !file.error()) {
-			size_t blockSize = size < FILE_BUF_SIZE ? size : FILE_BUF_SIZE;
-			file.read(buffer, blockSize);
-			if (file.error()) {
-				warn("%s: Could not read file", filename);
-				return;
-			}
-			size -= blockSize;
-			if (size > 0) {
-				crc16Block(&crc, buffer, blockSize);
-			} else {
-				crc16LastBlock(&crc, buffer, blockSize);
-			}
+/* returns false, if the file could not be read */
+bool LameTag::checkMusicCRC(bool &correct) {
+	unsigned short crc = 0;
+	size_t size = musicLength - frameLength;
+	char *buffer = new char[FILE_BUF_SIZE];
+	IFile file(filename);
+
+	file.seek(frameOffset + frameLength);
+	while (size > 0 && !file.eof() && !file.error()) {
+		size_t blockSize = size < FILE_BUF_SIZE ? size : FILE_BUF_SIZE;
+		file.read(buffer, blockSize);
+		if (file.error()) {
+			warn("%s: Could not read file", filename);
+			delete [] buffer;
+			return false;
+		}
+		size -= blockSize;
+		if (size > 0) {
+			crc16Block(&crc, buffer, blockSize);
+		} else {
+			crc16LastBlock(&crc, buffer, blockSize);
 		}
-		delete [] buffer;
-		cout << " (" << (crc != musicCRC ? "invalid" : "correct") << ")";
 	}
-	cout << endl;
+	delete [] buffer;
+	correct = crc == musicCRC;
+
+	return true;
+}
 
-	printf("%-16s: ", "ReplayGain: peak");
-	cout << (int) peakSignal * 100 << endl;
+const char* LameTag::encodingMethodName(int method) {
+	switch (method) {
+		case 1:
+			return "CBR";
+		case 2:
+			return "ABR";
+		case 3:
+			return "old/re VBR";
+		case 4:
+			return "new/mtrh VBR";
+		case 5:
+			return "new/mt VBR";
+		case 6:
+			return "VBR";
+		case 8:
+			return "2-pass CBR";
+		case 9:
+			return "2-pass ABR";
+		default:
+			return "unknown";
+	}
+}
 
-	printf("%-16s: ", "track gain");
-	tmp << (trackGain > 0.0 ? "+" : "") << trackGain << " dB";
-	printf("%-15s", tmp.str().c_str());
-	tmp.str("");
+const char* LameTag::stereoModeName(short mode) {
+	switch (mode) {
+		case 0:
+			return "mono";
+		case 1:
+			return "stereo";
+		case 2:
+			return "dual";
+		case 3:
+			return "joint";
+		case 4:
+			return "force";
+		case 5:
+			return "auto";
+		case 6:
+			return "intensity";
+		default:
+			return "undefined";
+	}
+}
 
-	printf("%-15s: ", "album gain");
-	cout << (albumGain > 0.0 ? "+" : "") << albumGain << " dB" << endl;
+const char* LameTag::sourceRateName(short rate) {
+	switch (rate) {
+		case 0:
+			return "<= 32";
+		case 1:
+			return "44.1";
+		case 2:
+			return "48";
+		default:
+			return "> 48";
+	}
 }
 
 double LameTag::replayGain(const ByteVector &gainData, bool oldVersion) {
@@ -22,16 +22,27 @@
 #include <taglib/tbytevector.h>
 
 #include "id3ted.h"
+#include "jsonwriter.h"
 
 class LameTag {
 	public:
 		LameTag(const char*, long, long);
 
 		bool isValid() const { return valid; }
+		const String& encoderVersion() const { return encoder; }
+		double trackReplayGain() const { return trackGain; }
+		double albumReplayGain() const { return albumGain; }
 		void print(bool);
+		void write(JsonWriter&, bool);
 
 	private:
 		double replayGain(const ByteVector&, bool);
+		bool checkTagCRC();
+		bool checkMusicCRC(bool&);
+
+		static const char* encodingMethodName(int);
+		static const char* stereoModeName(short);
+		static const char* sourceRateName(short);
 
 		/* calculate the crc16 checksum of a large chunk of data blockwise:
 		 * call crc16Block() for every block but the last one, making sure
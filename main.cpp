@@ -26,12 +26,24 @@
 #include <sys/stat.h>
 
 #include "id3ted.h"
+#include "copyengine.h"
+#include "duplicates.h"
+#include "exporter.h"
 #include "fileio.h"
 #include "frameinfo.h"
 #include "frametable.h"
+#include "journal.h"
+#include "jsonwriter.h"
+#include "writer.h"
 #include "mp3file.h"
 #include "options.h"
+#include "organizer.h"
 #include "pattern.h"
+#include "safewriter.h"
+#include "stats.h"
+#include "tagpack.h"
+
+static void printHeader(const char*, bool&);
 
 /* return values: (ored together)
  *   0: everything went fine
@@ -42,12 +54,67 @@
 int main(int argc, char **argv) {
 	int retCode = 0;
 	bool firstOutput = true;
+	long reclaimed = 0, compacted = 0;
+	Writer &out = Writer::out;
+	JsonWriter json(out);
+	Exporter *exporter = NULL;
+	ExportRow row;
+	Stats stats;
+	Duplicates duplicates;
+	SafeWriter safeWriter;
+	Journal journal;
+	TagPack dumpPack, loadPack;
+	string newPath, workPath;
 
 	if (Options::parseCommandLine(argc, argv)) {
 		cerr << "Try `" << argv[0] << " --help' for more information." << endl;
 		exit(2);
 	}
 
+	// built after parsing, it keeps its own copy of the policy
+	Organizer organizer(Options::conflictPolicy);
+
+	if (!Options::fields.isEmpty())
+		json.setFilter(&Options::fields);
+
+	if (Options::exportPath != NULL) {
+		exporter = Exporter::create(Options::exportFormat, Options::exportPath);
+		if (exporter == NULL)
+			exit(4);
+	}
+
+	if (Options::apicStore != NULL &&
+			FileIO::createDir(Options::apicStore) != FileIO::Success)
+		exit(4);
+
+	if (Options::organize && Options::copyJobs > 1)
+		FileIO::copyEngine = new CopyEngine(Options::copyJobs, COPY_MAX_IN_FLIGHT);
+
+	if (Options::saveProfile != NULL) {
+		TagProfile profile;
+		std::vector<FrameInfo*>::const_iterator frameInfo =
+				Options::framesToModify.begin();
+		for (; frameInfo != Options::framesToModify.end(); ++frameInfo) {
+			if (!profile.add(*frameInfo))
+				warn("--save-profile: --%s without text ignored", (*frameInfo)->id());
+		}
+		if (!profile.save(Options::saveProfile))
+			exit(4);
+		if (Options::fileCount == 0)
+			exit(0);
+	}
+
+	if (Options::rollbackPath != NULL)
+		exit(Journal::rollback(Options::rollbackPath, Options::copyJobs) ? 0 : 4);
+
+	if (Options::journalPath != NULL && !journal.open(Options::journalPath))
+		exit(4);
+
+	if (Options::dumpPath != NULL && !dumpPack.create(Options::dumpPath))
+		exit(4);
+	if (Options::loadPath != NULL && !loadPack.open(Options::loadPath))
+		exit(4);
+
 	for (uint fileIdx = 0; fileIdx < Options::fileCount; ++fileIdx) {
 		const char *filename = Options::filenames[fileIdx];
 		FileTimes ptimes;
@@ -66,105 +133,367 @@ int main(int argc, char **argv) {
 			continue;
 		}
 
-		if (Options::writeFile && !FileIO::isWritable(filename)) {
+		if ((Options::writeFile || Options::compact || Options::sidecarCovers ||
+		     Options::loadPath != NULL) && !FileIO::isWritable(filename)) {
 			warn("%s: Could not open file for writing", filename);
 			retCode |= 4;
 			continue;
 		}
 
-		MP3File file(filename, Options::tagsToWrite, Options::printLameTag);
-		if (!file.isValid()) {
+		// --where has to select the files, before anything is done to them
+		bool selected = false;
+		if (!Options::query.isEmpty() && (Options::dumpPath != NULL ||
+				Options::loadPath != NULL || Options::journalPath != NULL ||
+				Options::safeWrite)) {
+			MP3File probe(filename, 0, false);
+			if (!probe.isValid()) {
+				retCode |= 4;
+				continue;
+			}
+			if (!Options::query.matches(probe)) {
+				if (preserveTimes)
+					FileIO::resetTimes(filename, ptimes);
+				continue;
+			}
+			selected = true;
+		}
+
+		if (Options::dumpPath != NULL && !dumpPack.add(filename))
 			retCode |= 4;
+		if (Options::dumpOnly) {
+			if (preserveTimes)
+				FileIO::resetTimes(filename, ptimes);
 			continue;
 		}
 
-		if (Options::filenameToTag) {
-			uint matches = Options::inPattern.match(filename);
-			for (uint i = 0; i < matches; ++i)
-				file.apply(Options::inPattern.getMatch(i));
+		if (Options::extractOnly && MP3File::streamAPICs(filename,
+				Options::forceOverwrite, Options::apicStore)) {
+			if (preserveTimes)
+				FileIO::resetTimes(filename, ptimes);
+			continue;
+		}
+
+		if (Options::scanOnly) {
+			vector<ID3v2::Frame*> frames;
+			uint version;
+
+			if (MP3File::readFrames(filename, Options::fields, version, frames)) {
+				if (Options::outputFormat == FORMAT_JSON) {
+					json.beginObject();
+					json.key("file");
+					json.value(filename);
+					MP3File::writeFrames(json, version, frames);
+					json.endObject();
+				} else if (!frames.empty()) {
+					if (Options::fileCount > 1)
+						printHeader(filename, firstOutput);
+					MP3File::printFrames(version, frames, Options::listV2WithDesc);
+				}
+				for (uint i = 0; i < frames.size(); ++i)
+					delete frames[i];
+				if (preserveTimes)
+					FileIO::resetTimes(filename, ptimes);
+				continue;
+			}
 		}
 
-		if (Options::extractAPICs)
-			file.extractAPICs(Options::forceOverwrite);
+		bool modify = Options::writeFile || Options::compact ||
+		              Options::sidecarCovers || Options::loadPath != NULL;
+		bool safeWrite = Options::safeWrite && modify;
+		if (safeWrite) {
+			FileIO::Status ret = safeWriter.open(filename, workPath);
+			if (ret == FileIO::Error) {
+				retCode |= 4;
+				continue;
+			}
+			safeWrite = ret == FileIO::Success;
+		}
 
-		if (Options::framesToRemove.size() > 0 && Options::tagsToStrip & 2) {
-			warn("-r option ignored, because whole id3v2 tag gets stripped");
-			Options::framesToRemove.clear();
+		if (modify && Options::journalPath != NULL && !journal.record(filename,
+				safeWrite ? workPath.c_str() : filename)) {
+			if (safeWrite)
+				safeWriter.discard(workPath);
 			retCode |= 4;
-		} else {
-			std::vector<char*>::const_iterator frameID =
-					Options::framesToRemove.begin();
-			for (; frameID != Options::framesToRemove.end(); ++frameID) {
-				file.removeFrames(*frameID);
+			continue;
+		}
+
+		if (Options::loadPath != NULL) {
+			const char *target = safeWrite ? workPath.c_str() : filename;
+			FileIO::Status ret = loadPack.load(filename, target);
+			if (ret != FileIO::Success)
+				retCode |= 4;
+			if (Options::loadOnly) {
+				if (preserveTimes)
+					FileIO::resetTimes(target, ptimes);
+				if (safeWrite && ret != FileIO::Success)
+					safeWriter.discard(workPath);
+				else if (safeWrite && !safeWriter.commit(filename, workPath))
+					retCode |= 4;
+				continue;
 			}
 		}
 
-		std::vector<GenericInfo*>::const_iterator genInfo =
-				Options::genericMods.begin();
-		for (; genInfo != Options::genericMods.end(); ++genInfo)
-			file.apply(*genInfo);
+		// closed at the end of the block, before the file is committed,
+		// copied or moved
+		long fileSize;
+		{
+			MP3File file(filename, Options::tagsToWrite,
+			             Options::printLameTag || exporter != NULL ||
+			             Options::statsReport, safeWrite ? workPath.c_str() : NULL);
+			if (!file.isValid()) {
+				if (safeWrite)
+					safeWriter.discard(workPath);
+				retCode |= 4;
+				continue;
+			}
 
-		std::vector<FrameInfo*>::const_iterator frameInfo = 
-				Options::framesToModify.begin();
-		for (; frameInfo != Options::framesToModify.end(); ++frameInfo)
-			file.apply(*frameInfo);
+			bool matches = selected || Options::query.matches(file);
+			if (matches && Options::printMatches)
+				out << filename << '\n';
+			if (!matches || Options::printMatches) {
+				if (safeWrite)
+					safeWriter.discard(workPath);
+				if (preserveTimes)
+					FileIO::resetTimes(filename, ptimes);
+				continue;
+			}
 
-		if (Options::writeFile)
-			file.save();
+			// the copied tags are the base for all the other edits
+			if (Options::copyTags)
+				file.copy(Options::sourceTag);
 
-		if (Options::tagsToStrip != 0) {
-			if (!file.strip(Options::tagsToStrip)) {
-				warn("%s: Could not strip id3 tag", filename);
+			if (Options::filenameToTag) {
+				uint matches = Options::inPattern.match(filename);
+				for (uint i = 0; i < matches; ++i)
+					file.apply(Options::inPattern.getMatch(i));
+			}
+
+			if (Options::extractAPICs)
+				file.extractAPICs(Options::forceOverwrite, Options::apicStore);
+
+			// bytes of the pictures moved to sidecar files
+			long moved = 0;
+			if (Options::sidecarCovers && !file.moveAPICsToSidecar(moved)) {
+				warn("%s: Could not move attached pictures to sidecar files", filename);
+				retCode |= 4;
+			}
+
+			if (Options::framesToRemove.size() > 0 && Options::tagsToStrip & 2) {
+				warn("-r option ignored, because whole id3v2 tag gets stripped");
+				Options::framesToRemove.clear();
+				retCode |= 4;
+			} else {
+				std::vector<char*>::const_iterator frameID =
+						Options::framesToRemove.begin();
+				for (; frameID != Options::framesToRemove.end(); ++frameID) {
+					file.removeFrames(*frameID);
+				}
+			}
+
+			if (Options::applyProfile)
+				file.apply(Options::profile, Options::spliceProfile);
+
+			std::vector<GenericInfo*>::const_iterator genInfo =
+					Options::genericMods.begin();
+			for (; genInfo != Options::genericMods.end(); ++genInfo)
+				file.apply(*genInfo);
+
+			std::vector<FrameInfo*>::const_iterator frameInfo = 
+					Options::framesToModify.begin();
+			for (; frameInfo != Options::framesToModify.end(); ++frameInfo)
+				file.apply(*frameInfo);
+
+			if ((Options::writeFile || moved > 0) && !file.save()) {
+				warn("%s: Could not write file", filename);
 				retCode |= 4;
 			}
-		}
 
-		if (Options::showInfo || Options::listTags || Options::printLameTag) {
-			if (Options::fileCount > 1 && (Options::showInfo || 
-					(Options::listTags && (file.hasID3v1Tag() || file.hasID3v2Tag())) ||
-					(Options::printLameTag && file.hasLameTag()))) {
-				if (!firstOutput)
-					cout << endl;
-				else
-					firstOutput = false;
-				cout << filename << ":" << endl;
+			if (Options::tagsToStrip != 0) {
+				if (!file.strip(Options::tagsToStrip)) {
+					warn("%s: Could not strip id3 tag", filename);
+					retCode |= 4;
+				}
 			}
-			if (Options::showInfo)
-				file.showInfo();
-			if (Options::printLameTag)
-				file.printLameTag(Options::checkLameCRC);
-			if (Options::listTags) {
-				file.listID3v1Tag();
-				file.listID3v2Tag(Options::listV2WithDesc);
+
+			if (Options::compact)
+				compacted += file.compact(COMPACT_PADDING, COMPACT_MIN_SAVINGS);
+
+			reclaimed += moved;
+
+			if (Options::outputFormat == FORMAT_JSON) {
+				json.beginObject();
+				json.key("file");
+				json.value(filename);
+				if (Options::showInfo)
+					file.writeInfo(json);
+				if (Options::printLameTag)
+					file.writeLameTag(json, Options::checkLameCRC);
+				if (Options::listTags) {
+					if (Options::fields.isEmpty())
+						file.writeID3v1Tag(json);
+					file.writeID3v2Tag(json, Options::fields);
+				}
+				json.endObject();
+			} else if (Options::showInfo || Options::listTags || Options::printLameTag) {
+				if (Options::fileCount > 1 && (Options::showInfo || 
+						(Options::listTags && (file.hasID3v1Tag() || file.hasID3v2Tag())) ||
+						(Options::printLameTag && file.hasLameTag())))
+					printHeader(filename, firstOutput);
+				if (Options::showInfo)
+					file.showInfo();
+				if (Options::printLameTag)
+					file.printLameTag(Options::checkLameCRC);
+				if (Options::listTags) {
+					if (Options::fields.isEmpty())
+						file.listID3v1Tag();
+					file.listID3v2Tag(Options::listV2WithDesc, Options::fields);
+				}
+			}
+
+			if (exporter != NULL) {
+				row.clear();
+				file.fill(row);
+				exporter->add(row);
+			}
+
+			if (Options::statsReport)
+				stats.add(file);
+
+			if (Options::audioHash && !duplicates.add(file))
+				retCode |= 4;
+
+			if (Options::organize)
+				Options::outPattern.render(file, newPath, REPLACE_CHAR);
+
+			// taglib flushes its buffered writes, when it determines the size,
+			// but does not report errors on closing the file: compare the sizes
+			fileSize = file.size();
+		}
+		const char *target = safeWrite ? workPath.c_str() : filename;
+		if (modify && FileIO::size(target) != fileSize) {
+			warn("%s: Could not write file", filename);
+			retCode |= 4;
+			if (safeWrite) {
+				safeWriter.discard(workPath);
+				safeWrite = false;
 			}
 		}
 
+		if (safeWrite) {
+			if (preserveTimes)
+				FileIO::resetTimes(workPath.c_str(), ptimes);
+			if (!safeWriter.commit(filename, workPath))
+				retCode |= 4;
+			// -o needs the modified file at its original location right away
+			if (Options::organize && Options::conflictPolicy == CONFLICT_ASK &&
+					!safeWriter.flush())
+				retCode |= 4;
+		}
+
 		if (Options::organize) {
-			for (uint i = 0; i < Options::outPattern.count(); ++i) {
-				MatchInfo minfo = Options::outPattern.getMatch(i);
-				file.fill(minfo);
-				Options::outPattern.setMatch(i, minfo);
-			}
-			Options::outPattern.replaceSpecialChars(REPLACE_CHAR);
-			string newPath = Options::outPattern.getText();
-			if (!newPath.empty()) {
-				FileIO::Status ret = FileIO::copy(filename, newPath.c_str());
+			if (!newPath.empty() && Options::conflictPolicy != CONFLICT_ASK) {
+				// copied/moved after all files have been processed
+				organizer.add(filename, newPath, preserveTimes ? &ptimes : NULL);
+			} else if (!newPath.empty()) {
+				FileIO::Status ret = FileIO::copy(filename, newPath.c_str(),
+						Options::forceOverwrite ? FileIO::Always : FileIO::Ask,
+						preserveTimes ? &ptimes : NULL);
 				if (ret == FileIO::Error) {
 					warn("%s: Could not organize file", filename);
 					retCode |= 4;
-				} else if (ret == FileIO::Success && preserveTimes) {
-					FileIO::resetTimes(newPath.c_str(), ptimes);
 				}
 			}
 		}
 
-		if (preserveTimes && (!Options::organize || !Options::moveFiles))
+		if (preserveTimes && (!Options::organize || !Options::moveFiles ||
+		                      Options::conflictPolicy != CONFLICT_ASK))
 			FileIO::resetTimes(filename, ptimes);
 	}
 
+	if (!safeWriter.flush())
+		retCode |= 4;
+	if (!journal.close())
+		retCode |= 4;
+	if (!dumpPack.finish())
+		retCode |= 4;
+
+	if (Options::organize && Options::conflictPolicy != CONFLICT_ASK) {
+		if (!organizer.execute())
+			retCode |= 4;
+	}
+	if (FileIO::copyEngine != NULL) {
+		if (!FileIO::waitCopies())
+			retCode |= 4;
+		delete FileIO::copyEngine;
+		FileIO::copyEngine = NULL;
+	}
+
+	if (Options::statsReport) {
+		if (Options::outputFormat == FORMAT_JSON) {
+			stats.write(json);
+		} else {
+			if (!firstOutput)
+				out << '\n';
+			stats.print();
+		}
+	}
+
+	if (Options::audioHash) {
+		if (Options::outputFormat == FORMAT_JSON) {
+			duplicates.write(json);
+		} else {
+			if (!firstOutput || Options::statsReport)
+				out << '\n';
+			duplicates.print();
+		}
+	}
+
+	if (Options::outputFormat == FORMAT_JSON &&
+			(Options::sidecarCovers || Options::compact)) {
+		json.beginObject();
+		if (Options::sidecarCovers) {
+			json.key("sidecar_covers_reclaimed");
+			json.value(reclaimed);
+		}
+		if (Options::compact) {
+			json.key("compaction_saved");
+			json.value(compacted);
+		}
+		json.endObject();
+	} else {
+		if (Options::sidecarCovers) {
+			out << "sidecar covers: ";
+			out.putSize(reclaimed) << " reclaimed\n";
+		}
+		if (Options::compact) {
+			out << "compaction: ";
+			out.putSize(compacted) << " saved\n";
+		}
+	}
+
+	if (exporter != NULL) {
+		if (!exporter->finish())
+			retCode |= 4;
+		delete exporter;
+	}
+
+	if (!out.flush()) {
+		warn("Could not write output");
+		retCode |= 4;
+	}
+
 	return retCode;
 }
 
+/* separate the output for several files, using the filename as a header */
+static void printHeader(const char *filename, bool &firstOutput) {
+	if (!firstOutput)
+		Writer::out << '\n';
+	else
+		firstOutput = false;
+	Writer::out << filename << ":\n";
+}
+
 void warn(const char* fmt, ...) {
 	va_list args;
 
@@ -172,8 +501,11 @@ void warn(const char* fmt, ...) {
 		return;
 
 	va_start(args, fmt);
+	// keep the messages of the copy threads on separate lines
+	flockfile(stderr);
 	fprintf(stderr, "%s: ", PROGNAME);
 	vfprintf(stderr, fmt, args);
 	fprintf(stderr, "\n");
+	funlockfile(stderr);
 	va_end(args);
 }
@@ -16,15 +16,17 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
-#include <iostream>
 #include <sstream>
 #include <cctype>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <unistd.h>
 
 #include <taglib/id3v1tag.h>
 #include <taglib/id3v1genres.h>
 #include <taglib/id3v2tag.h>
+#include <taglib/id3v2framefactory.h>
 #include <taglib/attachedpictureframe.h>
 #include <taglib/commentsframe.h>
 #include <taglib/textidentificationframe.h>
@@ -34,10 +36,15 @@
 #include "mp3file.h"
 #include "fileio.h"
 #include "frametable.h"
+#include "hash.h"
+#include "tagscanner.h"
+#include "writer.h"
 
-MP3File::MP3File(const char *filename, int _tags, bool lame) :
-		file(filename), id3Tag(NULL), id3v1Tag(NULL), id3v2Tag(NULL),
-		lameTag(NULL), tags(_tags) {
+MP3File::MP3File(const char *filename, int _tags, bool lame,
+                 const char *workPath) :
+		path(filename), file(workPath != NULL ? workPath : filename),
+		id3Tag(NULL), id3v1Tag(NULL), id3v2Tag(NULL), lameTag(NULL),
+		tags(_tags), splicedProfile(NULL) {
 	if (file.isValid()) {
 		id3v1Tag = file.ID3v1Tag(tags & 1);
 		id3v2Tag = file.ID3v2Tag(tags & 2);
@@ -83,7 +90,206 @@ bool MP3File::hasID3v1Tag() const {
 }
 
 bool MP3File::hasID3v2Tag() const {
-	return id3v1Tag != NULL && !id3v2Tag->isEmpty();
+	return id3v2Tag != NULL && !id3v2Tag->isEmpty();
+}
+
+/* the text of the first id3v2 frame with the given id (genres resolved to
+ * their names), falling back to the id3v1 tag for the frames it has a
+ * field for */
+String MP3File::frameText(const ByteVector &frameID) const {
+	if (!file.isValid())
+		return String();
+
+	if (id3v2Tag != NULL) {
+		const ID3v2::FrameList &list = id3v2Tag->frameList(frameID);
+		if (!list.isEmpty()) {
+			if (frameID == "TCON")
+				return genreName(list.front()->toString());
+			return list.front()->toString();
+		}
+	}
+
+	if (id3v1Tag == NULL || id3v1Tag->isEmpty())
+		return String();
+
+	if (frameID == "TPE1")
+		return id3v1Tag->artist();
+	else if (frameID == "TALB")
+		return id3v1Tag->album();
+	else if (frameID == "TIT2")
+		return id3v1Tag->title();
+	else if (frameID == "COMM")
+		return id3v1Tag->comment();
+	else if (frameID == "TCON")
+		return id3v1Tag->genre();
+	else if (frameID == "TRCK" && id3v1Tag->track() > 0)
+		return String::number(id3v1Tag->track());
+	else if (frameID == "TDRC" && id3v1Tag->year() > 0)
+		return String::number(id3v1Tag->year());
+
+	return String();
+}
+
+/* the text of the first id3v2 frame with the given id and description,
+ * for the frames having one (COMM, TXXX, USLT, WXXX) */
+String MP3File::frameText(const ByteVector &frameID,
+                          const String &description) const {
+	if (!file.isValid() || id3v2Tag == NULL)
+		return String();
+
+	const ID3v2::FrameList &list = id3v2Tag->frameList(frameID);
+	ID3v2::FrameList::ConstIterator frame = list.begin();
+	for (; frame != list.end(); ++frame) {
+		switch (FrameTable::frameID(frameID)) {
+			case FID3_COMM: {
+				const ID3v2::CommentsFrame *comment =
+						dynamic_cast<const ID3v2::CommentsFrame*>(*frame);
+				if (comment != NULL && comment->description() == description)
+					return comment->text();
+				break;
+			}
+			case FID3_TXXX: {
+				const ID3v2::UserTextIdentificationFrame *userText =
+						dynamic_cast<const ID3v2::UserTextIdentificationFrame*>(*frame);
+				if (userText != NULL && userText->description() == description) {
+					StringList fields = userText->fieldList();
+					return fields.size() > 1 ? fields[1] : String();
+				}
+				break;
+			}
+			case FID3_USLT: {
+				const ID3v2::UnsynchronizedLyricsFrame *lyrics =
+						dynamic_cast<const ID3v2::UnsynchronizedLyricsFrame*>(*frame);
+				if (lyrics != NULL && lyrics->description() == description)
+					return lyrics->text();
+				break;
+			}
+			case FID3_WXXX: {
+				const ID3v2::UserUrlLinkFrame *userUrl =
+						dynamic_cast<const ID3v2::UserUrlLinkFrame*>(*frame);
+				if (userUrl != NULL && userUrl->description() == description)
+					return userUrl->url();
+				break;
+			}
+			default:
+				return String();
+		}
+	}
+
+	return String();
+}
+
+uint MP3File::frameCount(const ByteVector &frameID) const {
+	if (!file.isValid() || id3v2Tag == NULL)
+		return 0;
+
+	return id3v2Tag->frameList(frameID).size();
+}
+
+/* size of the largest id3v2 frame with the given id */
+uint MP3File::frameSize(const ByteVector &frameID) const {
+	uint size = 0;
+
+	if (!file.isValid() || id3v2Tag == NULL)
+		return 0;
+
+	const ID3v2::FrameList &list = id3v2Tag->frameList(frameID);
+	ID3v2::FrameList::ConstIterator frame = list.begin();
+	for (; frame != list.end(); ++frame) {
+		if ((*frame)->size() > size)
+			size = (*frame)->size();
+	}
+	return size;
+}
+
+/* total size of all id3v2 frames with the given id */
+unsigned long MP3File::frameBytes(const ByteVector &frameID) const {
+	unsigned long bytes = 0;
+
+	if (!file.isValid() || id3v2Tag == NULL)
+		return 0;
+
+	const ID3v2::FrameList &list = id3v2Tag->frameList(frameID);
+	ID3v2::FrameList::ConstIterator frame = list.begin();
+	for (; frame != list.end(); ++frame)
+		bytes += (*frame)->size();
+	return bytes;
+}
+
+/* major version of the id3v2 tag, 0 if the file has none */
+uint MP3File::id3v2Version() const {
+	if (!file.isValid() || !hasID3v2Tag())
+		return 0;
+
+	return id3v2Tag->header()->majorVersion();
+}
+
+/* size of the id3v2 tag in the file, including header and padding */
+long MP3File::id3v2Size() const {
+	if (!file.isValid() || !hasID3v2Tag())
+		return 0;
+
+	return id3v2Tag->header()->completeTagSize();
+}
+
+/* hash the mpeg audio data between the id3v2 tag and the id3v1/ape tags
+ * at the end of the file in large sequential blocks, so that files only
+ * differing in their tags get the same digest */
+bool MP3File::hashAudio(long &length, uint64_t &digest) {
+	ByteVector block;
+	Hash hash;
+	long offset, end;
+
+	if (!file.isValid())
+		return false;
+
+	// taglib skips the id3v2 tag, even an empty one, before searching
+	// for the first frame
+	offset = file.firstFrameOffset();
+	end = file.length();
+	if (offset < 0 || offset > end)
+		return false;
+
+	if (end - offset >= 128) {
+		file.seek(end - 128);
+		if (file.readBlock(3) == "TAG")
+			end -= 128;
+	}
+	if (end - offset >= 32) {
+		// ape tag footer: size of the items and the footer, header flag
+		file.seek(end - 32);
+		block = file.readBlock(32);
+		if (block.size() == 32 && block.startsWith("APETAGEX")) {
+			long apeSize = block.mid(12, 4).toUInt(false);
+			if (block.mid(20, 4).toUInt(false) & 0x80000000)
+				apeSize += 32;
+			if (apeSize <= end - offset)
+				end -= apeSize;
+		}
+	}
+
+	length = end - offset;
+	file.seek(offset);
+	while (offset < end) {
+		long blockSize = end - offset;
+		if (blockSize > AUDIO_HASH_BUF_SIZE)
+			blockSize = AUDIO_HASH_BUF_SIZE;
+		block = file.readBlock(blockSize);
+		if ((long) block.size() != blockSize)
+			return false;
+		hash.update(block);
+		offset += blockSize;
+	}
+	digest = hash.digest();
+
+	return true;
+}
+
+String MP3File::lameEncoder() const {
+	if (!file.isValid() || !hasLameTag())
+		return String();
+
+	return lameTag->encoderVersion();
 }
 
 void MP3File::apply(GenericInfo *info) {
@@ -154,84 +360,94 @@ void MP3File::apply(FrameInfo *info) {
 				id3v2Tag->removeFrame(*eachFrame);
 		}
 	} else {
-		if (frameList.empty() || info->fid() == FID3_APIC) {
-			switch (info->fid()) {
-				case FID3_APIC: {
-					ID3v2::AttachedPictureFrame *apic;
-					for (; eachFrame != frameList.end(); ++eachFrame) {
-						apic = dynamic_cast<ID3v2::AttachedPictureFrame*>(*eachFrame);
-						if (apic != NULL && apic->picture() == info->data())
-							return;
-					}
-					apic = new ID3v2::AttachedPictureFrame();
-					apic->setMimeType(info->description());
-					apic->setType(ID3v2::AttachedPictureFrame::FrontCover);
-					apic->setPicture(info->data());
-					id3v2Tag->addFrame(apic);
-					break;
-				}
-				case FID3_COMM: {
-					if (info->text().isEmpty())
-						return;
-					ID3v2::CommentsFrame *comment = new ID3v2::CommentsFrame(DEF_TSTR_ENC);
-					comment->setText(info->text());
-					comment->setDescription(info->description());
-					comment->setLanguage(info->language());
-					id3v2Tag->addFrame(comment);
-					break;
-				}
-				case FID3_TXXX: {
-					ID3v2::UserTextIdentificationFrame *userText =
-							new ID3v2::UserTextIdentificationFrame(DEF_TSTR_ENC);
-					userText->setText(info->text());
-					userText->setDescription(info->description());
-					id3v2Tag->addFrame(userText);
-					break;
-				}
-				case FID3_USLT: {
-					ID3v2::UnsynchronizedLyricsFrame *lyrics =
-							new ID3v2::UnsynchronizedLyricsFrame(DEF_TSTR_ENC);
-					lyrics->setText(info->text());
-					lyrics->setDescription(info->description());
-					lyrics->setLanguage(info->language());
-					id3v2Tag->addFrame(lyrics);
-					break;
-				}
-				case FID3_WCOM:
-				case FID3_WCOP:
-				case FID3_WOAF:
-				case FID3_WOAR:
-				case FID3_WOAS:
-				case FID3_WORS:
-				case FID3_WPAY:
-				case FID3_WPUB: {
-					ID3v2::UrlLinkFrame *urlLink = new ID3v2::UrlLinkFrame(info->id());
-					urlLink->setUrl(info->text());
-					id3v2Tag->addFrame(urlLink);
-					break;
-				}
-				case FID3_WXXX: {
-					ID3v2::UserUrlLinkFrame *userUrl =
-							new ID3v2::UserUrlLinkFrame(DEF_TSTR_ENC);
-					userUrl->setUrl(info->text());
-					userUrl->setDescription(info->description());
-					id3v2Tag->addFrame(userUrl);
-					break;
-				}
-				default: {
-					ID3v2::TextIdentificationFrame *textFrame =
-							new ID3v2::TextIdentificationFrame(info->id(), DEF_TSTR_ENC);
-					textFrame->setText(info->text());
-					id3v2Tag->addFrame(textFrame);
-					break;
-				}
-			}
-		} else {
+		if (frameList.empty()) {
+			id3v2Tag->addFrame(info->createFrame());
+		} else if (info->fid() != FID3_APIC) {
+			// find() only returns the frames holding the same picture,
+			// so an existing APIC frame is left untouched
 			frameList.front()->setText(info->text());
 		}
 	}
 }
 
+/* every frame of the profile replaces the frames of the tag with the same
+ * key, attached pictures are only added if the tag does not already hold
+ * the same picture. if splice is given, the frames are not added to the
+ * tag, but their pre-rendered data is spliced into it by save(), which
+ * then has to be the last access to the tag. */
+void MP3File::apply(const TagProfile &profile, bool splice) {
+	if (!file.isValid() || file.readOnly())
+		return;
+	if (id3v2Tag == NULL)
+		return;
+
+	if (splice && tags == 2) {
+		const vector<ID3v2::Frame*> &frames = profile.frames();
+		vector<ID3v2::Frame*>::const_iterator frame = frames.begin();
+
+		for (; frame != frames.end(); ++frame) {
+			if ((*frame)->frameID() == "APIC")
+				continue;
+			ID3v2::FrameList frameList = id3v2Tag->frameList((*frame)->frameID());
+			ID3v2::FrameList::Iterator each = frameList.begin();
+			for (; each != frameList.end(); ++each) {
+				if (sameKey(*each, *frame))
+					id3v2Tag->removeFrame(*each);
+			}
+		}
+		splicedProfile = &profile;
+		return;
+	}
+
+	vector<ID3v2::Frame*> frames = profile.createFrames();
+	vector<ID3v2::Frame*>::iterator frame = frames.begin();
+
+	for (; frame != frames.end(); ++frame) {
+		// copy the list, the tag's one changes while removing frames
+		ID3v2::FrameList frameList = id3v2Tag->frameList((*frame)->frameID());
+		ID3v2::FrameList::Iterator each = frameList.begin();
+		bool present = false;
+
+		for (; each != frameList.end() && !present; ++each) {
+			if ((*frame)->frameID() == "APIC")
+				present = sameFrame(*each, *frame);
+			else if (sameKey(*each, *frame))
+				id3v2Tag->removeFrame(*each);
+		}
+
+		if (present)
+			delete *frame;
+		else
+			id3v2Tag->addFrame(*frame);
+	}
+}
+
+/* replace the whole id3v2 tag with the frames of the profile and
+ * overwrite the id3v1 tag with the corresponding information */
+void MP3File::copy(const TagProfile &profile) {
+	if (!file.isValid() || file.readOnly())
+		return;
+	if (id3v2Tag == NULL) {
+		// only written, if the tag version to write includes id3v2
+		id3v2Tag = file.ID3v2Tag(true);
+		if (id3v2Tag == NULL)
+			return;
+	}
+
+	ID3v2::FrameList frameList = id3v2Tag->frameList();
+	ID3v2::FrameList::Iterator each = frameList.begin();
+	for (; each != frameList.end(); ++each)
+		id3v2Tag->removeFrame(*each);
+
+	vector<ID3v2::Frame*> frames = profile.createFrames();
+	vector<ID3v2::Frame*>::iterator frame = frames.begin();
+	for (; frame != frames.end(); ++frame)
+		id3v2Tag->addFrame(*frame);
+
+	if (id3v1Tag != NULL && tags & 1)
+		Tag::duplicate(id3v2Tag, id3v1Tag, true);
+}
+
 void MP3File::apply(const MatchInfo &info) {
 	if (!file.isValid() || file.readOnly())
 		return;
@@ -287,6 +503,9 @@ void MP3File::fill(MatchInfo &info) {
 			if (text.empty())
 				text = "Unknown Title";
 			break;
+		case 'c':
+			text = id3Tag->comment().toCString(USE_UTF8);
+			break;
 		case 'g':
 			text = id3Tag->genre().toCString(USE_UTF8);
 			break;
@@ -323,6 +542,40 @@ void MP3File::fill(MatchInfo &info) {
 	}
 }
 
+/* fill in the columns of an --export row */
+void MP3File::fill(ExportRow &row) {
+	static const struct {
+		ExportColumn column;
+		const char *id;
+	} frameColumns[] = {
+		{ EXP_TPE1, "TPE1" }, { EXP_TPE2, "TPE2" }, { EXP_TALB, "TALB" },
+		{ EXP_TIT2, "TIT2" }, { EXP_TRCK, "TRCK" }, { EXP_TPOS, "TPOS" },
+		{ EXP_TDRC, "TDRC" }, { EXP_TCON, "TCON" }
+	};
+	MPEG::Properties *properties;
+
+	if (!file.isValid())
+		return;
+
+	row.set(EXP_PATH, path);
+	row.set(EXP_SIZE, file.length());
+
+	for (uint i = 0; i < sizeof(frameColumns) / sizeof(frameColumns[0]); ++i)
+		row.set(frameColumns[i].column, frameText(frameColumns[i].id));
+
+	if ((properties = file.audioProperties()) != NULL) {
+		row.set(EXP_BITRATE, (long) properties->bitrate());
+		row.set(EXP_SAMPLE_RATE, (long) properties->sampleRate());
+		row.set(EXP_LENGTH, (long) properties->length());
+	}
+
+	if (hasLameTag()) {
+		row.set(EXP_ENCODER, lameTag->encoderVersion());
+		row.set(EXP_TRACK_GAIN, (long) floor(lameTag->trackReplayGain() * 10 + 0.5));
+		row.set(EXP_ALBUM_GAIN, (long) floor(lameTag->albumReplayGain() * 10 + 0.5));
+	}
+}
+
 void MP3File::removeFrames(const char *textFID) {
 	if (textFID == NULL)
 		return;
@@ -337,23 +590,167 @@ bool MP3File::save() {
 	if (!file.isValid() || file.readOnly())
 		return false;
 
+	if (splicedProfile != NULL)
+		return saveSpliced();
+
 	// bug in TagLib 1.5.0?: deleting solely frame in id3v2 tag and
 	// then saving file causes the recovery of the last deleted frame.
 	// solution: strip the whole tag if it is empty before writing file!
 	if (tags & 2 && id3v2Tag != NULL && id3v2Tag->isEmpty())
 		strip(2);
 
+	if (tags == 1 && id3v1Tag != NULL) {
+		// like taglib: convert v2 to v1 tag, if the v1 tag is incomplete
+		if (id3v2Tag != NULL)
+			Tag::duplicate(id3v2Tag, id3v1Tag, false);
+		if (!id3v1Tag->isEmpty())
+			return saveID3v1();
+	}
+
 	return file.save(tags, false);
 }
 
+/* the id3v1 tag is a fixed size trailer, so it can be overwritten in place
+ * or appended to the file with a single write, without letting taglib
+ * parse and rewrite the rest of the file */
+bool MP3File::saveID3v1() {
+	bool present = false;
+
+	if (file.length() >= 128) {
+		file.seek(-128, File::End);
+		present = file.readBlock(3) == ID3v1::Tag::fileIdentifier();
+	}
+
+	ByteVector tag = id3v1Tag->render();
+	file.seek(present ? -128 : 0, File::End);
+	file.writeBlock(tag);
+
+	// taglib does not report write errors: read the tag back and let
+	// taglib save the file on failure
+	file.seek(-128, File::End);
+	if (!file.isOpen() || file.readBlock(128) != tag)
+		return file.save(tags, false);
+
+	return true;
+}
+
+/* write the id3v2 tag with the pre-rendered frames of the applied profile
+ * appended to the tag's own frames. a frame of the profile is left out, if
+ * a later edit has set a frame with the same key or the tag already holds
+ * the same picture. the tag is written into the space of the old one, if
+ * it fits, so that the rest of the file is not moved. */
+bool MP3File::saveSpliced() {
+	const TagProfile &profile = *splicedProfile;
+	const vector<ID3v2::Frame*> &frames = profile.frames();
+	ByteVector spliced;
+
+	splicedProfile = NULL;
+
+	for (uint i = 0; i < frames.size(); ++i) {
+		ID3v2::FrameList frameList = id3v2Tag->frameList(frames[i]->frameID());
+		ID3v2::FrameList::ConstIterator each = frameList.begin();
+		bool overridden = false;
+
+		for (; each != frameList.end() && !overridden; ++each) {
+			if (frames[i]->frameID() == "APIC")
+				overridden = sameFrame(*each, frames[i]);
+			else
+				overridden = sameKey(*each, frames[i]);
+		}
+		if (!overridden)
+			spliced.append(profile.rendered(i));
+	}
+
+	long oldSize = 0;
+	file.seek(0);
+	ByteVector block = file.readBlock(ID3v2::Header::size());
+	if (block.startsWith(ID3v2::Header::fileIdentifier()))
+		oldSize = ID3v2::Header(block).completeTagSize();
+
+	// the profile's frames are id3v2.4 frames, like taglib writes them
+	ByteVector data = renderFrames(4) + spliced;
+	long size = ID3v2::Header::size() + data.size();
+	uint padding = size <= oldSize ? oldSize - size : PROFILE_PADDING;
+
+	file.insert(renderID3v2(data, 4, padding), 0, oldSize);
+
+	return file.isOpen();
+}
+
 bool MP3File::strip(int tags) {
 	if (!file.isValid() || file.readOnly())
 		return false;
 
-	return file.strip(tags);
+	if (!file.strip(tags))
+		return false;
+
+	// taglib has deleted the stripped tags
+	if (tags & 1)
+		id3v1Tag = NULL;
+	if (tags & 2)
+		id3v2Tag = NULL;
+
+	return true;
+}
+
+/* remove duplicate frames and rewrite the id3v2 tag with the given amount
+ * of padding, if this saves at least minSavings bytes. returns the number
+ * of bytes saved. has to be the last write access to the file, because
+ * taglib does not know about the new tag size. */
+long MP3File::compact(uint padding, uint minSavings) {
+	if (!file.isValid() || file.readOnly())
+		return 0;
+	if (id3v2Tag == NULL || id3v2Tag->isEmpty())
+		return 0;
+
+	file.seek(0);
+	if (file.readBlock(3) != ID3v2::Header::fileIdentifier())
+		// tag is not located at the beginning of the file
+		return 0;
+
+	// keep the version of the tag, taglib can not write id3v2.2 tags
+	uint version = id3v2Tag->header()->majorVersion();
+	if (version < 3)
+		version = 4;
+
+	// every frame is rendered only once, the duplicates are found by
+	// comparing the rendered frames with the same key
+	vector<ID3v2::Frame*> kept;
+	vector<ByteVector> rendered;
+	ByteVector frames;
+	ID3v2::FrameList::ConstIterator each = id3v2Tag->frameList().begin();
+
+	for (; each != id3v2Tag->frameList().end(); ++each) {
+		ByteVector data = renderFrame(*each, version);
+		if (data.isEmpty())
+			continue;
+
+		uint i = 0;
+		for (; i < kept.size(); ++i) {
+			if (sameKey(kept[i], *each) && rendered[i] == data)
+				break;
+		}
+		if (i < kept.size())
+			continue;
+
+		kept.push_back(*each);
+		rendered.push_back(data);
+		frames.append(data);
+	}
+
+	long oldSize = id3v2Tag->header()->completeTagSize();
+	ByteVector tag = renderID3v2(frames, version, padding);
+
+	if (oldSize - (long) tag.size() < (long) minSavings)
+		return 0;
+
+	file.insert(tag, 0, oldSize);
+
+	return oldSize - tag.size();
 }
 
 void MP3File::showInfo() const {
+	Writer &out = Writer::out;
 	MPEG::Properties *properties;
 	const char *version;
 	const char *channelMode;
@@ -364,38 +761,17 @@ void MP3File::showInfo() const {
 	if ((properties = file.audioProperties()) == NULL)
 		return;
 
-	switch (properties->version()) {
-		case 1:
-			version = "2";
-			break;
-		case 2:
-			version = "2.5";
-			break;
-		default:
-			version = "1";
-			break;
-	}
-
-	switch (properties->channelMode()) {
-		case 0:
-			channelMode = "Stereo";
-			break;
-		case 1:
-			channelMode = "JointStereo";
-			break;
-		case 2:
-			channelMode = "DualChannel";
-			break;
-		default:
-			channelMode = "SingleChannel";
-			break;
-	}
+	version = versionName(properties->version());
+	channelMode = channelModeName(properties->channelMode());
 
 	int length = properties->length();
-	printf("MPEG %s Layer %d %s\n", version, properties->layer(), channelMode);
-	printf("bitrate: %d kBit/s, sample rate: %d Hz, length: %02d:%02d:%02d\n",
-			properties->bitrate(), properties->sampleRate(),
-			length / 3600, length / 60, length % 60);
+	out << "MPEG " << version << " Layer " << properties->layer() << ' '
+	    << channelMode << '\n';
+	out << "bitrate: " << properties->bitrate() << " kBit/s, sample rate: "
+	    << properties->sampleRate() << " Hz, length: ";
+	out.putNumber(length / 3600, 2) << ':';
+	out.putNumber(length / 60 % 60, 2) << ':';
+	out.putNumber(length % 60, 2) << '\n';
 }
 
 void MP3File::printLameTag(bool checkCRC) const {
@@ -407,6 +783,8 @@ void MP3File::printLameTag(bool checkCRC) const {
 }
 
 void MP3File::listID3v1Tag() const {
+	Writer &out = Writer::out;
+
 	if (!file.isValid())
 		return;
 	if (id3v1Tag == NULL || id3v1Tag->isEmpty())
@@ -416,44 +794,72 @@ void MP3File::listID3v1Tag() const {
 	TagLib::String genreStr = id3v1Tag->genre();
 	int genre = ID3v1::genreIndex(genreStr);
 	
-	printf("ID3v1:\n");
-	printf("Title  : %-30s  Track: %d\n",
-			id3v1Tag->title().toCString(USE_UTF8), id3v1Tag->track());
-	printf("Artist : %-30s  Year : %-4s\n",
-			id3v1Tag->artist().toCString(USE_UTF8),
-			(year != 0 ? TagLib::String::number(year).toCString() : ""));
-	printf("Album  : %-30s  Genre: %s (%d)\n",
-			id3v1Tag->album().toCString(USE_UTF8),
-			(genre == 255 ? "Unknown" : genreStr.toCString()), genre);
-	printf("Comment: %s\n", id3v1Tag->comment().toCString(USE_UTF8));
-}
-
-void MP3File::listID3v2Tag(bool withDesc) const {
+	out << "ID3v1:\n";
+	out << "Title  : ";
+	out.putPadded(id3v1Tag->title(), 30) << "  Track: " << id3v1Tag->track()
+	    << '\n';
+	out << "Artist : ";
+	out.putPadded(id3v1Tag->artist(), 30) << "  Year : ";
+	out.putPadded(year != 0 ? TagLib::String::number(year) : "", 4) << '\n';
+	out << "Album  : ";
+	out.putPadded(id3v1Tag->album(), 30) << "  Genre: ";
+	if (genre == 255)
+		out << "Unknown";
+	else
+		out << genreStr;
+	out << " (" << genre << ")\n";
+	out << "Comment: " << id3v1Tag->comment() << '\n';
+}
+
+void MP3File::listID3v2Tag(bool withDesc, const FieldList &fields) const {
 	if (!file.isValid())
 		return;
 	if (id3v2Tag == NULL || id3v2Tag->isEmpty())
 		return;
 
-	int frameCount = id3v2Tag->frameList().size(); 
-	cout << "ID3v2." << id3v2Tag->header()->majorVersion() << " - "
-	     << frameCount << (frameCount != 1 ? " frames:" : " frame:") << endl;
-	
+	printFrames(id3v2Tag->header()->majorVersion(), select(fields), withDesc);
+}
+
+/* the frames of the id3v2 tag, which are selected by fields */
+vector<ID3v2::Frame*> MP3File::select(const FieldList &fields) const {
+	vector<ID3v2::Frame*> frames;
+
 	ID3v2::FrameList::ConstIterator frame = id3v2Tag->frameList().begin();
 	for (; frame != id3v2Tag->frameList().end(); ++frame) {
+		if (fields.contains((*frame)->frameID()))
+			frames.push_back(*frame);
+	}
+
+	return frames;
+}
+
+void MP3File::printFrames(uint version, const vector<ID3v2::Frame*> &frames,
+                          bool withDesc) {
+	Writer &out = Writer::out;
+	int frameCount = frames.size();
+
+	if (frames.empty())
+		return;
+
+	out << "ID3v2." << version << " - "
+	    << frameCount << (frameCount != 1 ? " frames:" : " frame:") << '\n';
+	
+	vector<ID3v2::Frame*>::const_iterator frame = frames.begin();
+	for (; frame != frames.end(); ++frame) {
 		String textFID((*frame)->frameID(), DEF_TSTR_ENC);
 
-		cout << textFID;
+		out << textFID;
 		if (withDesc)
-			cout << " (" << FrameTable::frameDescription(textFID) << ")";
-		cout << ": ";
+			out << " (" << FrameTable::frameDescription(textFID) << ")";
+		out << ": ";
 		
 		switch (FrameTable::frameID(textFID)) {
 			case FID3_APIC: {
 				ID3v2::AttachedPictureFrame *apic =
 						dynamic_cast<ID3v2::AttachedPictureFrame*>(*frame);
 				if (apic != NULL) {
-					int size = apic->picture().size();
-					cout << apic->mimeType() << ", " << FileIO::sizeHumanReadable(size);
+					out << apic->mimeType() << ", ";
+					out.putSize(apic->picture().size());
 				}
 				break;
 			}
@@ -461,29 +867,14 @@ void MP3File::listID3v2Tag(bool withDesc) const {
 				ID3v2::CommentsFrame *comment =
 						dynamic_cast<ID3v2::CommentsFrame*>(*frame);
 				if (comment != NULL) {
-					TagLib::ByteVector lang = comment->language();
-					bool showLanguage = lang.size() == 3 && isalpha(lang[0]) && 
-					                    isalpha(lang[1]) && isalpha(lang[2]);
-
-					cout << "[" << comment->description().toCString(USE_UTF8) << "]";
-					if (showLanguage)
-						cout << "(" << lang[0] << lang[1] << lang[2];
-					else
-						cout << "(XXX";
-					cout << "): " << comment->toString().toCString(USE_UTF8);
+					out << "[" << comment->description() << "]("
+					    << languageName(comment->language()) << "): "
+					    << comment->toString();
 				}
 				break;
 			}
 			case FID3_TCON: {
-				String genreStr = (*frame)->toString();
-				int genre = 255;
-
-				sscanf(genreStr.toCString(), "(%d)", &genre);
-				if (genre == 255)
-					sscanf(genreStr.toCString(), "%d", &genre);
-				if (genre != 255)
-					genreStr = ID3v1::genre(genre);
-				cout << genreStr;
+				out << genreName((*frame)->toString());
 				break;
 			}
 			case FID3_USLT: {
@@ -492,23 +883,17 @@ void MP3File::listID3v2Tag(bool withDesc) const {
 				if (lyrics != NULL) {
 					const char *text = lyrics->text().toCString(USE_UTF8);
 					const char *indent = "    ";
-					TagLib::ByteVector lang = lyrics->language();
-					bool showLanguage = lang.size() == 3 && isalpha(lang[0]) && 
-					                    isalpha(lang[1]) && isalpha(lang[2]);
-
-					cout << "[" << lyrics->description().toCString(USE_UTF8) << "]";
-					if (showLanguage)
-						cout << "(" << lang[0] << lang[1] << lang[2];
-					else
-						cout << "(XXX";
-					cout << "):\n" << indent;
-					while (*text != '\0') {
-						if (*text == (char) 10 || *text == (char) 13)
-							cout << "\n" << indent;
-						else
-							putchar(*text);
-						++text;
+					const char *line = text;
+
+					out << "[" << lyrics->description() << "]("
+					    << languageName(lyrics->language()) << "):\n" << indent;
+					for (; *text != '\0'; ++text) {
+						if (*text == (char) 10 || *text == (char) 13) {
+							out.write(line, text - line) << '\n' << indent;
+							line = text + 1;
+						}
 					}
+					out.write(line, text - line);
 				}
 				break;
 			}
@@ -517,10 +902,9 @@ void MP3File::listID3v2Tag(bool withDesc) const {
 						dynamic_cast<ID3v2::UserTextIdentificationFrame*>(*frame);
 				if (userText != NULL) {
 					StringList textList = userText->fieldList();
-					cout << "[" << userText->description().toCString(USE_UTF8)
-					     << "]: ";
+					out << "[" << userText->description() << "]: ";
 					if (textList.size() > 1)
-						cout << textList[1].toCString(USE_UTF8);
+						out << textList[1];
 				}
 				break;
 			}
@@ -528,29 +912,248 @@ void MP3File::listID3v2Tag(bool withDesc) const {
 				ID3v2::UserUrlLinkFrame *userUrl =
 						dynamic_cast<ID3v2::UserUrlLinkFrame*>(*frame);
 				if (userUrl != NULL)
-					cout << "[" << userUrl->description().toCString(USE_UTF8)
-					     << "]: " << userUrl->url().toCString(USE_UTF8);
+					out << "[" << userUrl->description() << "]: " << userUrl->url();
 				break;
 			}
 			case FID3_XXXX: {
 				break;
 			}
 			default:
-				cout << (*frame)->toString().toCString(USE_UTF8);
+				out << (*frame)->toString();
 				break;
 		}
-		cout << endl;
+		out << '\n';
 	}
 }
 
-void MP3File::extractAPICs(bool overwrite) const {
+void MP3File::writeInfo(JsonWriter &json) const {
+	MPEG::Properties *properties;
+
+	if (!file.isValid())
+		return;
+	if ((properties = file.audioProperties()) == NULL)
+		return;
+
+	json.key("info");
+	json.beginObject();
+	if (json.field("version"))
+		json.value(versionName(properties->version()));
+	if (json.field("layer"))
+		json.value(properties->layer());
+	if (json.field("channel_mode"))
+		json.value(channelModeName(properties->channelMode()));
+	if (json.field("bitrate"))
+		json.value(properties->bitrate());
+	if (json.field("sample_rate"))
+		json.value(properties->sampleRate());
+	if (json.field("length"))
+		json.value(properties->length());
+	json.endObject();
+}
+
+void MP3File::writeLameTag(JsonWriter &json, bool checkCRC) const {
+	if (!file.isValid() || !hasLameTag())
+		return;
+
+	json.key("lame");
+	lameTag->write(json, checkCRC);
+}
+
+void MP3File::writeID3v1Tag(JsonWriter &json) const {
+	if (!file.isValid())
+		return;
+	if (id3v1Tag == NULL || id3v1Tag->isEmpty())
+		return;
+
+	json.key("id3v1");
+	json.beginObject();
+	json.key("title");
+	json.value(id3v1Tag->title());
+	json.key("artist");
+	json.value(id3v1Tag->artist());
+	json.key("album");
+	json.value(id3v1Tag->album());
+	json.key("year");
+	json.value((long) id3v1Tag->year());
+	json.key("comment");
+	json.value(id3v1Tag->comment());
+	json.key("track");
+	json.value((long) id3v1Tag->track());
+	json.key("genre");
+	json.value(ID3v1::genreIndex(id3v1Tag->genre()));
+	json.endObject();
+}
+
+void MP3File::writeID3v2Tag(JsonWriter &json, const FieldList &fields) const {
+	if (!file.isValid())
+		return;
+	if (id3v2Tag == NULL || id3v2Tag->isEmpty())
+		return;
+
+	writeFrames(json, id3v2Tag->header()->majorVersion(), select(fields));
+}
+
+void MP3File::writeFrames(JsonWriter &json, uint version,
+                          const vector<ID3v2::Frame*> &frames) {
+	if (frames.empty())
+		return;
+
+	json.key("id3v2");
+	json.beginObject();
+	json.key("version");
+	json.value((long) version);
+	json.key("frames");
+	json.beginArray();
+
+	vector<ID3v2::Frame*>::const_iterator frame = frames.begin();
+	for (; frame != frames.end(); ++frame) {
+		String textFID((*frame)->frameID(), DEF_TSTR_ENC);
+
+		json.beginObject();
+		json.key("id");
+		json.value(textFID);
+
+		switch (FrameTable::frameID(textFID)) {
+			case FID3_APIC: {
+				ID3v2::AttachedPictureFrame *apic =
+						dynamic_cast<ID3v2::AttachedPictureFrame*>(*frame);
+				if (apic != NULL) {
+					json.key("mimetype");
+					json.value(apic->mimeType());
+					json.key("type");
+					json.value((int) apic->type());
+					json.key("description");
+					json.value(apic->description());
+					json.key("size");
+					json.value((long) apic->picture().size());
+				}
+				break;
+			}
+			case FID3_COMM: {
+				ID3v2::CommentsFrame *comment =
+						dynamic_cast<ID3v2::CommentsFrame*>(*frame);
+				if (comment != NULL) {
+					json.key("description");
+					json.value(comment->description());
+					json.key("language");
+					json.value(languageName(comment->language()));
+					json.key("text");
+					json.value(comment->toString());
+				}
+				break;
+			}
+			case FID3_TCON: {
+				json.key("text");
+				json.value(genreName((*frame)->toString()));
+				break;
+			}
+			case FID3_USLT: {
+				ID3v2::UnsynchronizedLyricsFrame *lyrics =
+						dynamic_cast<ID3v2::UnsynchronizedLyricsFrame*>(*frame);
+				if (lyrics != NULL) {
+					json.key("description");
+					json.value(lyrics->description());
+					json.key("language");
+					json.value(languageName(lyrics->language()));
+					json.key("text");
+					json.value(lyrics->text());
+				}
+				break;
+			}
+			case FID3_TXXX: {
+				ID3v2::UserTextIdentificationFrame *userText =
+						dynamic_cast<ID3v2::UserTextIdentificationFrame*>(*frame);
+				if (userText != NULL) {
+					StringList textList = userText->fieldList();
+					json.key("description");
+					json.value(userText->description());
+					json.key("text");
+					json.value(textList.size() > 1 ? textList[1] : String());
+				}
+				break;
+			}
+			case FID3_WXXX: {
+				ID3v2::UserUrlLinkFrame *userUrl =
+						dynamic_cast<ID3v2::UserUrlLinkFrame*>(*frame);
+				if (userUrl != NULL) {
+					json.key("description");
+					json.value(userUrl->description());
+					json.key("url");
+					json.value(userUrl->url());
+				}
+				break;
+			}
+			case FID3_XXXX: {
+				json.key("size");
+				json.value((long) (*frame)->size());
+				break;
+			}
+			default:
+				json.key("text");
+				json.value((*frame)->toString());
+				break;
+		}
+		json.endObject();
+	}
+
+	json.endArray();
+	json.endObject();
+}
+
+const char* MP3File::versionName(int version) {
+	switch (version) {
+		case 1:
+			return "2";
+		case 2:
+			return "2.5";
+		default:
+			return "1";
+	}
+}
+
+const char* MP3File::channelModeName(int channelMode) {
+	switch (channelMode) {
+		case 0:
+			return "Stereo";
+		case 1:
+			return "JointStereo";
+		case 2:
+			return "DualChannel";
+		default:
+			return "SingleChannel";
+	}
+}
+
+/* resolve numerical genres like "(17)" or "17" into their names */
+String MP3File::genreName(const String &genreStr) {
+	int genre = 255;
+
+	sscanf(genreStr.toCString(), "(%d)", &genre);
+	if (genre == 255)
+		sscanf(genreStr.toCString(), "%d", &genre);
+	if (genre != 255)
+		return ID3v1::genre(genre);
+
+	return genreStr;
+}
+
+/* the language code of a comment or lyrics frame, "XXX" if invalid */
+String MP3File::languageName(const ByteVector &lang) {
+	if (lang.size() == 3 && isalpha(lang[0]) && isalpha(lang[1]) &&
+			isalpha(lang[2]))
+		return String(lang);
+
+	return "XXX";
+}
+
+void MP3File::extractAPICs(bool overwrite, const char *store) const {
 	if (!file.isValid() || id3v2Tag == NULL)
 		return;
 
-	int num = 0;
-	const char *mimetype, *filetype;
-	ostringstream filename;
+	if (streamAPICs(path, overwrite, store))
+		return;
 
+	int num = 0;
 	ID3v2::FrameList apicList = id3v2Tag->frameListMap()["APIC"];
 	ID3v2::FrameList::ConstIterator each = apicList.begin();
 
@@ -560,38 +1163,364 @@ void MP3File::extractAPICs(bool overwrite) const {
 		if (apic == NULL)
 			continue;
 
-		mimetype = apic->mimeType().toCString();
-		if (mimetype != NULL && strlen(mimetype) > 0) {
-			filetype = strrchr(mimetype, '/');
-			if (filetype != NULL && strlen(filetype+1) > 0)
-				++filetype;
-			else
-				filetype = mimetype;
-		} else {
-			filetype = "bin";
+		APICSource source;
+		source.mimetype = apic->mimeType();
+		source.data = apic->picture();
+		source.path = NULL;
+		extractAPIC(source, ++num, path, overwrite, store);
+	}
+}
+
+/* decode only the frames selected by fields, skipping the others by only
+ * reading their headers. the caller owns the frames. returns false, if the
+ * tag can not be read this way and has to be parsed by taglib. */
+bool MP3File::readFrames(const char *filename, const FieldList &fields,
+                         uint &version, vector<ID3v2::Frame*> &frames) {
+	TagScanner scanner(filename);
+	ID3v2::Header header;
+	ID3v2::FrameFactory *factory = ID3v2::FrameFactory::instance();
+
+	if (!scanner.isValid())
+		return false;
+	version = scanner.majorVersion();
+	if (version == 0)
+		// no tag at all
+		return true;
+	if (version == 3 && (fields.contains("TDRC") || fields.contains("TDOR")))
+		// taglib builds these from several id3v2.3 frames
+		return false;
+
+	header.setMajorVersion(version);
+
+	vector<RawFrame>::const_iterator frame = scanner.frames().begin();
+	for (; frame != scanner.frames().end(); ++frame) {
+		if (!fields.contains(frame->id))
+			continue;
+
+		ByteVector data;
+		if (frame->plain)
+			data = scanner.readFrame(*frame);
+		if (data.isEmpty()) {
+			for (uint i = 0; i < frames.size(); ++i)
+				delete frames[i];
+			frames.clear();
+			return false;
 		}
 
-		filename.str("");
-		filename << file.name() << ".apic-" << (++num < 10 ? "0" : "");
-		filename << num << "." << filetype;
+		ID3v2::Frame *decoded = factory->createFrame(data, &header);
+		if (decoded != NULL)
+			frames.push_back(decoded);
+	}
 
-		if (FileIO::exists(filename.str().c_str())) {
-			if (!overwrite && !FileIO::confirmOverwrite(filename.str().c_str()))
-				continue;
+	return true;
+}
+
+/* extract the pictures by copying them directly from the file, without
+ * loading them into memory. returns false, if the tag can not be scanned
+ * and the pictures have to be extracted using taglib. */
+bool MP3File::streamAPICs(const char *filename, bool overwrite,
+                          const char *store) {
+	TagScanner scanner(filename);
+	vector<APICSource> apics;
+
+	if (!scanner.isValid())
+		return false;
+
+	vector<RawFrame>::const_iterator frame = scanner.frames().begin();
+	for (; frame != scanner.frames().end(); ++frame) {
+		if (frame->id != "APIC")
+			continue;
+
+		APICSource source;
+		source.path = filename;
+		if (!scanner.locatePicture(*frame, source.mimetype, source.offset,
+		                           source.length))
+			return false;
+		apics.push_back(source);
+	}
+
+	for (uint i = 0; i < apics.size(); ++i)
+		extractAPIC(apics[i], i + 1, filename, overwrite, store);
+
+	return true;
+}
+
+void MP3File::extractAPIC(const APICSource &source, int num,
+                          const char *filename, bool overwrite,
+                          const char *store) {
+	const char *mimetype, *filetype;
+	ostringstream apicName;
+
+	mimetype = source.mimetype.toCString();
+	if (mimetype != NULL && strlen(mimetype) > 0) {
+		filetype = strrchr(mimetype, '/');
+		if (filetype != NULL && strlen(filetype+1) > 0)
+			++filetype;
+		else
+			filetype = mimetype;
+	} else {
+		filetype = "bin";
+	}
+
+	apicName << filename << ".apic-" << (num < 10 ? "0" : "");
+	apicName << num << "." << filetype;
+
+	if (FileIO::exists(apicName.str().c_str())) {
+		if (!overwrite && !FileIO::confirmOverwrite(apicName.str().c_str()))
+			return;
+	}
+
+	if (store != NULL)
+		storeAPIC(source, filetype, store, apicName.str().c_str());
+	else
+		writeAPIC(source, apicName.str().c_str());
+}
+
+FileIO::Status MP3File::writeAPIC(const APICSource &source, const char *to) {
+	if (source.path != NULL)
+		return FileIO::copyRange(source.path, source.offset, source.length, to);
+
+	OFile outFile(to);
+	if (!outFile.isOpen())
+		return FileIO::Error;
+
+	outFile.write(source.data);
+	if (outFile.error()) {
+		warn("%s: Could not write file", to);
+		outFile.close();
+		FileIO::remove(to);
+		return FileIO::Error;
+	}
+	outFile.close();
+
+	return FileIO::Success;
+}
+
+void MP3File::storeAPIC(const APICSource &source, const char *filetype,
+                        const char *store, const char *linkName) {
+	ostringstream hashName, temp;
+	uint64_t hash;
+
+	if (source.path != NULL) {
+		IFile inFile(source.path);
+		if (!Hash::of(inFile, source.offset, source.length, hash)) {
+			warn("%s: Could not read file", source.path);
+			return;
+		}
+	} else {
+		hash = Hash::of(source.data);
+	}
+
+	hashName << hex;
+	hashName.width(16);
+	hashName.fill('0');
+	hashName << hash << "." << filetype;
+	string storeName = string(store) + "/" + hashName.str();
+
+	// every distinct picture is only written once per run, pictures
+	// stored by earlier runs are recognized by their name. the picture
+	// is written to a temporary file in the store, so that an interrupted
+	// run never leaves a truncated picture under its final name
+	if (storedAPICs.find(storeName) == storedAPICs.end()) {
+		if (!FileIO::exists(storeName.c_str())) {
+			temp << store << "/." << hashName.str() << ".id3ted-" << getpid();
+			if (writeAPIC(source, temp.str().c_str()) != FileIO::Success)
+				return;
+			if (rename(temp.str().c_str(), storeName.c_str()) != 0) {
+				warn("%s: Could not rename file to: %s", temp.str().c_str(),
+				     storeName.c_str());
+				FileIO::remove(temp.str().c_str());
+				return;
+			}
 		}
+		storedAPICs.insert(storeName);
+	}
 
-		OFile outFile(filename.str().c_str());
+	if (FileIO::exists(linkName) && FileIO::remove(linkName) != FileIO::Success)
+		return;
+
+	if (FileIO::link(storeName.c_str(), linkName) != FileIO::Success) {
+		// no hardlinks possible, e.g. on another filesystem:
+		// record the picture belonging to linkName in the manifest
+		string manifest = string(store) + "/manifest";
+		string line = string(linkName) + "\t" + storeName + "\n";
+		set<string> &lines = manifestLines(manifest);
+
+		if (lines.find(line) != lines.end())
+			// recorded by this or an earlier run
+			return;
+
+		OFile outFile(manifest.c_str(), true);
 		if (!outFile.isOpen())
-			continue;
+			return;
 
-		outFile.write(apic->picture());
+		outFile.write(line.c_str(), line.length());
 		if (outFile.error())
-			warn("%s: Could not write file", filename.str().c_str());
-
+			warn("%s: Could not write file", manifest.c_str());
+		else
+			lines.insert(line);
 		outFile.close();
 	}
 }
 
+/* the lines of the given --apic-store manifest, read only once per run */
+set<string>& MP3File::manifestLines(const string &manifest) {
+	map<string, set<string> >::iterator found = manifests.find(manifest);
+	if (found != manifests.end())
+		return found->second;
+
+	set<string> &lines = manifests[manifest];
+	if (!FileIO::exists(manifest.c_str()))
+		return lines;
+
+	IFile inFile(manifest.c_str());
+	ByteVector data;
+	inFile.read(data);
+	if (inFile.error()) {
+		warn("%s: Could not read file", manifest.c_str());
+		return lines;
+	}
+
+	string text(data.data(), data.size());
+	size_t start = 0, end;
+	while ((end = text.find('\n', start)) != string::npos) {
+		lines.insert(text.substr(start, end - start + 1));
+		start = end + 1;
+	}
+
+	return lines;
+}
+
+/* move the attached pictures to sidecar files named cover[-NUM].FORMAT in
+ * the directory of the file, writing every distinct picture only once per
+ * directory. the frames are only removed, if all pictures could be saved;
+ * moved is set to the size of the removed frames. */
+bool MP3File::moveAPICsToSidecar(long &moved) {
+	moved = 0;
+	if (!file.isValid() || file.readOnly() || id3v2Tag == NULL)
+		return false;
+
+	ID3v2::FrameList apicList = id3v2Tag->frameListMap()["APIC"];
+	ID3v2::FrameList::ConstIterator each = apicList.begin();
+
+	if (apicList.isEmpty())
+		return true;
+
+	string dirname = path;
+	size_t lastSlash = dirname.rfind('/');
+	dirname = lastSlash != string::npos ? dirname.substr(0, lastSlash + 1) : "";
+
+	for (; each != apicList.end(); ++each) {
+		ID3v2::AttachedPictureFrame *apic =
+				dynamic_cast<ID3v2::AttachedPictureFrame*>(*each);
+		if (apic == NULL)
+			return false;
+
+		APICSource source;
+		source.mimetype = apic->mimeType();
+		source.data = apic->picture();
+		source.path = NULL;
+		if (!saveSidecar(source, dirname))
+			return false;
+	}
+
+	uint headerSize = ID3v2::Frame::headerSize(id3v2Tag->header()->majorVersion());
+	for (each = apicList.begin(); each != apicList.end(); ++each)
+		moved += headerSize + (*each)->size();
+
+	removeFrames("APIC");
+	// let taglib render the tag with its minimal padding,
+	// instead of padding it to its old size
+	id3v2Tag->header()->setTagSize(0);
+
+	return true;
+}
+
+bool MP3File::saveSidecar(const APICSource &source, const string &dirname) {
+	const char *mimetype = source.mimetype.toCString();
+	const char *filetype = strrchr(mimetype, '/');
+	map<uint64_t, string> &covers = sidecars[dirname];
+	uint64_t hash = Hash::of(source.data);
+
+	if (filetype != NULL && strlen(filetype+1) > 0)
+		++filetype;
+	else if (strlen(mimetype) > 0)
+		filetype = mimetype;
+	else
+		filetype = "bin";
+
+	if (covers.find(hash) != covers.end())
+		return true;
+
+	for (int num = 1; ; ++num) {
+		ostringstream name;
+		uint64_t fileHash;
+		map<uint64_t, string>::const_iterator cover = covers.begin();
+
+		name << dirname << "cover";
+		if (num > 1)
+			name << "-" << num;
+		name << "." << filetype;
+
+		for (; cover != covers.end() && cover->second != name.str(); ++cover);
+		if (cover != covers.end())
+			continue;
+
+		if (!FileIO::exists(name.str().c_str())) {
+			if (writeAPIC(source, name.str().c_str()) != FileIO::Success)
+				return false;
+			covers[hash] = name.str();
+			return true;
+		}
+
+		// saved by an earlier run or by someone else
+		IFile inFile(name.str().c_str());
+		if (!Hash::of(inFile, 0, FileIO::size(name.str().c_str()), fileHash)) {
+			warn("%s: Could not read file", name.str().c_str());
+			return false;
+		}
+		covers[fileHash] = name.str();
+		if (fileHash == hash)
+			return true;
+	}
+}
+
+/* render the id3v2 tag like taglib does, but with exactly the given
+ * amount of padding; taglib pads the tag to its old size */
+ByteVector MP3File::renderID3v2(const ByteVector &frames, uint version,
+                                uint padding) {
+	ID3v2::Header header;
+
+	header.setMajorVersion(version);
+	header.setTagSize(frames.size() + padding);
+
+	return header.render() + frames + ByteVector(padding, 0);
+}
+
+/* the frames of the id3v2 tag rendered for the given id3v2 version */
+ByteVector MP3File::renderFrames(uint version) const {
+	ByteVector frames;
+	ID3v2::FrameList::ConstIterator frame = id3v2Tag->frameList().begin();
+
+	for (; frame != id3v2Tag->frameList().end(); ++frame)
+		frames.append(renderFrame(*frame, version));
+
+	return frames;
+}
+
+/* empty, if the frame should be discarded or has no content */
+ByteVector MP3File::renderFrame(ID3v2::Frame *frame, uint version) {
+	frame->header()->setVersion(version);
+	if (frame->header()->tagAlterPreservation())
+		return ByteVector();
+
+	ByteVector data = frame->render();
+	if (data.size() <= ID3v2::Frame::headerSize(version))
+		return ByteVector();
+
+	return data;
+}
+
 vector<ID3v2::Frame*> MP3File::find(FrameInfo *info) {
 	vector<ID3v2::Frame*> list;
 
@@ -608,8 +1537,8 @@ vector<ID3v2::Frame*> MP3File::find(FrameInfo *info) {
 						dynamic_cast<ID3v2::AttachedPictureFrame*>(*each);
 				if (apic == NULL)
 					continue;
-				if (info->data() == apic->picture() &&
-						info->description() == apic->mimeType())
+				if (info->description() == apic->mimeType() &&
+						samePicture(info, apic->picture()))
 					list.push_back(*each);
 				break;
 			}
@@ -662,3 +1591,97 @@ vector<ID3v2::Frame*> MP3File::find(FrameInfo *info) {
 	}
 	return list;
 }
+
+bool MP3File::samePicture(const FrameInfo *info, const ByteVector &picture) {
+	// compare the sizes first, the pictures only need to be hashed,
+	// if they are equal; the hash of info's picture is precomputed
+	if (info->data().size() != picture.size())
+		return false;
+	if (picture.isEmpty())
+		return true;
+
+	return info->hash() == Hash::of(picture);
+}
+
+/* two frames are duplicates, if find() regards them as the same frame
+ * and their content is identical */
+bool MP3File::sameFrame(const ID3v2::Frame *frame1, const ID3v2::Frame *frame2) {
+	return sameKey(frame1, frame2) && frame1->render() == frame2->render();
+}
+
+/* the rules of find() applied to two frames: they have the same id and
+ * description/language; for attached pictures the mime-type and the size
+ * of the pictures have to match */
+bool MP3File::sameKey(const ID3v2::Frame *frame1, const ID3v2::Frame *frame2) {
+	if (frame1->frameID() != frame2->frameID())
+		return false;
+
+	switch (FrameTable::frameID(frame1->frameID())) {
+		case FID3_APIC: {
+			const ID3v2::AttachedPictureFrame *apic1 =
+					dynamic_cast<const ID3v2::AttachedPictureFrame*>(frame1);
+			const ID3v2::AttachedPictureFrame *apic2 =
+					dynamic_cast<const ID3v2::AttachedPictureFrame*>(frame2);
+			if (apic1 == NULL || apic2 == NULL)
+				return false;
+			if (apic1->mimeType() != apic2->mimeType() ||
+					apic1->picture().size() != apic2->picture().size())
+				return false;
+			break;
+		}
+		case FID3_COMM: {
+			const ID3v2::CommentsFrame *comment1 =
+					dynamic_cast<const ID3v2::CommentsFrame*>(frame1);
+			const ID3v2::CommentsFrame *comment2 =
+					dynamic_cast<const ID3v2::CommentsFrame*>(frame2);
+			if (comment1 == NULL || comment2 == NULL)
+				return false;
+			if (comment1->description() != comment2->description() ||
+					comment1->language() != comment2->language())
+				return false;
+			break;
+		}
+		case FID3_TXXX: {
+			const ID3v2::UserTextIdentificationFrame *userText1 =
+					dynamic_cast<const ID3v2::UserTextIdentificationFrame*>(frame1);
+			const ID3v2::UserTextIdentificationFrame *userText2 =
+					dynamic_cast<const ID3v2::UserTextIdentificationFrame*>(frame2);
+			if (userText1 == NULL || userText2 == NULL)
+				return false;
+			if (userText1->description() != userText2->description())
+				return false;
+			break;
+		}
+		case FID3_USLT: {
+			const ID3v2::UnsynchronizedLyricsFrame *lyrics1 =
+					dynamic_cast<const ID3v2::UnsynchronizedLyricsFrame*>(frame1);
+			const ID3v2::UnsynchronizedLyricsFrame *lyrics2 =
+					dynamic_cast<const ID3v2::UnsynchronizedLyricsFrame*>(frame2);
+			if (lyrics1 == NULL || lyrics2 == NULL)
+				return false;
+			if (lyrics1->description() != lyrics2->description() ||
+					lyrics1->language() != lyrics2->language())
+				return false;
+			break;
+		}
+		case FID3_WXXX: {
+			const ID3v2::UserUrlLinkFrame *userUrl1 =
+					dynamic_cast<const ID3v2::UserUrlLinkFrame*>(frame1);
+			const ID3v2::UserUrlLinkFrame *userUrl2 =
+					dynamic_cast<const ID3v2::UserUrlLinkFrame*>(frame2);
+			if (userUrl1 == NULL || userUrl2 == NULL)
+				return false;
+			if (userUrl1->description() != userUrl2->description())
+				return false;
+			break;
+		}
+		default:
+			break;
+	}
+
+	return true;
+}
+
+set<string> MP3File::storedAPICs;
+map<string, set<string> > MP3File::manifests;
+map<string, map<uint64_t, string> > MP3File::sidecars;
@@ -19,54 +19,125 @@
 #ifndef MP3FILE_H
 #define MP3FILE_H
 
+#include <map>
+#include <set>
+#include <string>
 #include <vector>
 
 #include <taglib/mpegfile.h>
 #include <taglib/id3v2frame.h>
 
 #include "id3ted.h"
+#include "exporter.h"
+#include "fileio.h"
+#include "fieldlist.h"
 #include "frameinfo.h"
 #include "genericinfo.h"
+#include "jsonwriter.h"
 #include "lametag.h"
 #include "pattern.h"
+#include "tagprofile.h"
+
+typedef struct {
+	String mimetype;
+	ByteVector data;   // the picture, if it has been loaded,
+	const char *path;  // otherwise (if not NULL) its location in the file
+	long offset;
+	long length;
+} APICSource;
 
 class MP3File {
 	public:
-		explicit MP3File(const char*, int, bool);
+		explicit MP3File(const char*, int, bool, const char* = NULL);
 		~MP3File();
 
 		bool isValid() const { return file.isValid(); }
 		bool isReadOnly() const { return file.readOnly(); }
-		const char* filename() const { return file.name(); }
+		const char* filename() const { return path; }
+		long size() { return file.length(); }
 
 		bool hasLameTag() const;
 		bool hasID3v1Tag() const;
 		bool hasID3v2Tag() const;
 
+		String frameText(const ByteVector&) const;
+		String frameText(const ByteVector&, const String&) const;
+		uint frameCount(const ByteVector&) const;
+		uint frameSize(const ByteVector&) const;
+		unsigned long frameBytes(const ByteVector&) const;
+		uint id3v2Version() const;
+		long id3v2Size() const;
+		String lameEncoder() const;
+		bool hashAudio(long&, uint64_t&);
+		const MPEG::Properties* audioProperties() const { return file.audioProperties(); }
+
 		void apply(GenericInfo*);
 		void apply(FrameInfo*);
+		void apply(const TagProfile&, bool);
 		void apply(const MatchInfo&);
 		void fill(MatchInfo&);
+		void fill(ExportRow&);
 		void removeFrames(const char*);
+		void copy(const TagProfile&);
+		bool moveAPICsToSidecar(long&);
 		bool save();
 		bool strip(int);
+		long compact(uint, uint);
 
 		void showInfo() const;
 		void printLameTag(bool) const;
 		void listID3v1Tag() const;
-		void listID3v2Tag(bool) const;
+		void listID3v2Tag(bool, const FieldList&) const;
+
+		void writeInfo(JsonWriter&) const;
+		void writeLameTag(JsonWriter&, bool) const;
+		void writeID3v1Tag(JsonWriter&) const;
+		void writeID3v2Tag(JsonWriter&, const FieldList&) const;
 
-		void extractAPICs(bool) const;
+		static bool readFrames(const char*, const FieldList&, uint&,
+		                       vector<ID3v2::Frame*>&);
+		static void printFrames(uint, const vector<ID3v2::Frame*>&, bool);
+		static void writeFrames(JsonWriter&, uint, const vector<ID3v2::Frame*>&);
+
+		void extractAPICs(bool, const char*) const;
+		static bool streamAPICs(const char*, bool, const char*);
 
 	private:
-		MPEG::File file;
+		const char *path;  // the file is accessed at a different location,
+		MPEG::File file;   // if it is modified in a copy with --safe-write
 		Tag *id3Tag;
 		ID3v1::Tag *id3v1Tag;
 		ID3v2::Tag *id3v2Tag;
 		LameTag *lameTag;
 		int tags;
+		const TagProfile *splicedProfile;
 
 		vector<ID3v2::Frame*> find(FrameInfo*);
+		vector<ID3v2::Frame*> select(const FieldList&) const;
+		ByteVector renderFrames(uint) const;
+		bool saveID3v1();
+		bool saveSpliced();
+
+		static const char* versionName(int);
+		static const char* channelModeName(int);
+		static String genreName(const String&);
+		static String languageName(const ByteVector&);
+		static bool samePicture(const FrameInfo*, const ByteVector&);
+		static bool sameFrame(const ID3v2::Frame*, const ID3v2::Frame*);
+		static bool sameKey(const ID3v2::Frame*, const ID3v2::Frame*);
+		static ByteVector renderID3v2(const ByteVector&, uint, uint);
+		static ByteVector renderFrame(ID3v2::Frame*, uint);
+		static void extractAPIC(const APICSource&, int, const char*, bool,
+		                        const char*);
+		static FileIO::Status writeAPIC(const APICSource&, const char*);
+		static void storeAPIC(const APICSource&, const char*, const char*,
+		                      const char*);
+		static set<string>& manifestLines(const string&);
+		static bool saveSidecar(const APICSource&, const string&);
+
+		static set<string> storedAPICs;
+		static map<string, set<string> > manifests;
+		static map<string, map<uint64_t, string> > sidecars;
 };
 
 #endif /* MP3FILE_H */
@@ -100,6 +100,43 @@ bool Options::parseCommandLine(int argc, char **argv) {
 			case 'm':
 				printLameTag = true;
 				break;
+			case OPT_LO_FIELDS:
+				if (!fields.parse(optarg))
+					error = true;
+				break;
+			case OPT_LO_FORMAT:
+				if (strcmp(optarg, "text") == 0) {
+					outputFormat = FORMAT_TEXT;
+				} else if (strcmp(optarg, "json") == 0) {
+					outputFormat = FORMAT_JSON;
+				} else {
+					warn("--format: invalid output format: %s", optarg);
+					error = true;
+				}
+				break;
+			case OPT_LO_STATS:
+				statsReport = true;
+				break;
+			case OPT_LO_AUDIO_HASH:
+				audioHash = true;
+				break;
+			case OPT_LO_WHERE:
+				if (!query.parse(optarg))
+					error = true;
+				break;
+			case OPT_LO_EXPORT:
+				exportPath = optarg;
+				break;
+			case OPT_LO_EXPORT_FORMAT:
+				if (strcmp(optarg, "tsv") == 0) {
+					exportFormat = EXPORT_TSV;
+				} else if (strcmp(optarg, "columns") == 0) {
+					exportFormat = EXPORT_COLUMNS;
+				} else {
+					warn("--export-format: invalid export format: %s", optarg);
+					error = true;
+				}
+				break;
 			/* tag removal & version to write */
 			case 'r':
 				if (FrameTable::frameID(optarg) != FID3_XXXX) {
@@ -146,12 +183,87 @@ bool Options::parseCommandLine(int argc, char **argv) {
 			case 'x':
 				extractAPICs = true;
 				break;
+			case OPT_LO_APIC_STORE:
+				apicStore = optarg;
+				extractAPICs = true;
+				break;
+			case OPT_LO_SIDECAR:
+				sidecarCovers = true;
+				break;
+			case OPT_LO_COMPACT:
+				compact = true;
+				break;
+			case OPT_LO_SAFE_WRITE:
+				safeWrite = true;
+				break;
+			case OPT_LO_JOURNAL:
+				journalPath = optarg;
+				break;
+			case OPT_LO_ROLLBACK:
+				rollbackPath = optarg;
+				break;
+			case OPT_LO_DUMP_TAGS:
+				dumpPath = optarg;
+				break;
+			case OPT_LO_LOAD_TAGS:
+				loadPath = optarg;
+				break;
+			case OPT_LO_PROFILE:
+				if (profile.load(optarg)) {
+					applyProfile = true;
+					writeFile = true;
+				} else {
+					error = true;
+				}
+				break;
+			case OPT_LO_SAVE_PROFILE:
+				saveProfile = optarg;
+				break;
+			case OPT_LO_COPY_TAGS:
+				if (sourceTag.copyFrom(optarg)) {
+					copyTags = true;
+					writeFile = true;
+				} else {
+					error = true;
+				}
+				break;
 			case 'f':
 				forceOverwrite = true;
 				break;
 			case OPT_LO_ORG_MOVE:
 				moveFiles = true;
 				break;
+			case OPT_LO_ORG_LINK:
+				linkFiles = true;
+				break;
+			case OPT_LO_ORG_SYMLINK:
+				symlinkFiles = true;
+				break;
+			case OPT_LO_JOBS: {
+				char *end;
+				long jobs = strtol(optarg, &end, 10);
+				if (*optarg == '\0' || *end != '\0' || jobs < 1 || jobs > 256) {
+					warn("--jobs: invalid number of copies: %s", optarg);
+					error = true;
+				} else {
+					copyJobs = jobs;
+				}
+				break;
+			}
+			case OPT_LO_CONFLICT:
+				if (strcmp(optarg, "ask") == 0) {
+					conflictPolicy = CONFLICT_ASK;
+				} else if (strcmp(optarg, "suffix") == 0) {
+					conflictPolicy = CONFLICT_SUFFIX;
+				} else if (strcmp(optarg, "skip") == 0) {
+					conflictPolicy = CONFLICT_SKIP;
+				} else if (strcmp(optarg, "overwrite") == 0) {
+					conflictPolicy = CONFLICT_OVERWRITE;
+				} else {
+					warn("--conflict: invalid policy: %s", optarg);
+					error = true;
+				}
+				break;
 			/* id3v2 frame id long options */
 			case 0: {
 				ID3v2FrameID fid = (ID3v2FrameID) optFrameID;
@@ -190,27 +302,147 @@ bool Options::parseCommandLine(int argc, char **argv) {
 			     framesToModify[0]->id());
 			error = true;
 		}
+		if (moveFiles && (linkFiles || symlinkFiles)) {
+			warn("Conflicting options: --move, --%s", linkFiles ? "link" : "symlink");
+			error = true;
+		}
+		if (linkFiles && symlinkFiles) {
+			warn("Conflicting options: --link, --symlink");
+			error = true;
+		}
+		if (tagsToWrite == 1 && applyProfile) {
+			warn("Conflicting options: -1, --profile");
+			error = true;
+		}
+		if (tagsToStrip & 2 && applyProfile) {
+			warn("Conflicting options: strip id3v2 tag, --profile");
+			error = true;
+		}
+		if (saveProfile != NULL && framesToModify.empty()) {
+			warn("--save-profile: no frames given to save");
+			error = true;
+		}
+		if (tagsToWrite == 1 && sidecarCovers) {
+			warn("Conflicting options: -1, --sidecar-covers");
+			error = true;
+		}
+		if (tagsToStrip & 2 && compact) {
+			warn("Conflicting options: strip id3v2 tag, --compact");
+			error = true;
+		}
 		if (tagsToStrip & tagsToWrite) {
 			warn("Conflicting options: strip and write the same tag version");
 			error = true;
 		}
+		if (rollbackPath != NULL && fileCount > 0) {
+			warn("Conflicting options: --rollback, <FILES>");
+			error = true;
+		}
 		// check for missing mandatory arguments
 		if (optind == 1) {
 			warn("Missing arguments");
 			error = true;
-		} else if (fileCount == 0) {
+		} else if (fileCount == 0 && saveProfile == NULL && rollbackPath == NULL) {
 			warn("Missing <FILES>");
 			error = true;
 		}
 	}
 
 	if (tagsToWrite == 0 &&
-			(framesToModify.size() > 0 || inPattern.needsID3v2()))
+			(framesToModify.size() > 0 || applyProfile || copyTags ||
+			 inPattern.needsID3v2()))
 		tagsToWrite = 2;
 
+	if (!fields.isEmpty()) {
+		// show what the selected fields belong to
+		if (!showInfo && !listTags && !printLameTag) {
+			showInfo = fields.selects(FIELD_INFO);
+			listTags = fields.selects(FIELD_FRAME);
+			printLameTag = fields.selects(FIELD_LAME);
+		} else {
+			showInfo = showInfo && fields.selects(FIELD_INFO);
+			listTags = listTags && fields.selects(FIELD_FRAME);
+			printLameTag = printLameTag && fields.selects(FIELD_LAME);
+		}
+	}
+
+	// json output without anything to show: list the tags
+	if (outputFormat == FORMAT_JSON && !showInfo && !printLameTag &&
+			!statsReport && !audioHash)
+		listTags = true;
+
+	// the files are read as little as possible, if only one action is
+	// requested; --where selects the files before they are dumped or loaded
+	uint requested = actions();
+	extractOnly = requested == ACTION_EXTRACT;
+	scanOnly = requested == ACTION_LIST && !fields.isEmpty();
+	printMatches = requested == ACTION_QUERY;
+	loadOnly = (requested & ~ACTION_QUERY) == ACTION_LOAD;
+	dumpOnly = (requested & ~ACTION_QUERY) == ACTION_DUMP;
+
+	// the profile's frames are spliced into the tags, when the files are
+	// saved, if nothing reads or rewrites the tags afterwards and no later
+	// edit removes frames, which might be ones of the profile
+	spliceProfile = applyProfile && tagsToWrite == 2 && tagsToStrip == 0 &&
+	                !compact && !listTags && !organize && exportPath == NULL &&
+	                !statsReport && !audioHash && !removesFrames();
+
 	return error;
 }
 
+uint Options::actions() {
+	uint requested = 0;
+
+	if (writeFile)
+		requested |= ACTION_WRITE;
+	if (compact)
+		requested |= ACTION_COMPACT;
+	if (sidecarCovers)
+		requested |= ACTION_SIDECAR;
+	if (showInfo)
+		requested |= ACTION_INFO;
+	if (listTags)
+		requested |= ACTION_LIST;
+	if (printLameTag)
+		requested |= ACTION_LAME;
+	if (extractAPICs)
+		requested |= ACTION_EXTRACT;
+	if (organize)
+		requested |= ACTION_ORGANIZE;
+	if (exportPath != NULL)
+		requested |= ACTION_EXPORT;
+	if (statsReport)
+		requested |= ACTION_STATS;
+	if (audioHash)
+		requested |= ACTION_HASH;
+	if (!query.isEmpty())
+		requested |= ACTION_QUERY;
+	if (dumpPath != NULL)
+		requested |= ACTION_DUMP;
+	if (loadPath != NULL)
+		requested |= ACTION_LOAD;
+
+	return requested;
+}
+
+/* -[aAtcgTy] and --FID with an empty argument remove the frames */
+bool Options::removesFrames() {
+	vector<GenericInfo*>::const_iterator genInfo = genericMods.begin();
+	for (; genInfo != genericMods.end(); ++genInfo) {
+		if ((*genInfo)->value().isEmpty() ||
+				((*genInfo)->id() == 'y' && (*genInfo)->value().toInt() == 0))
+			return true;
+	}
+
+	vector<FrameInfo*>::const_iterator frameInfo = framesToModify.begin();
+	for (; frameInfo != framesToModify.end(); ++frameInfo) {
+		if ((*frameInfo)->text().isEmpty() && (*frameInfo)->fid() != FID3_APIC)
+			return true;
+	}
+
+	return false;
+}
+
 void Options::printVersion() {
 	cout << PROGNAME << " " << VERSION << " - command line id3 tag editor\n"
 	     << "Uses TagLib v" << TAGLIB_MAJOR_VERSION << "."
@@ -243,7 +475,30 @@ void Options::printUsage() {
 	     << "  -l, --list             list the tags on the files\n"
 	     << "  -L, --list-wd          same as -l, but list id3v2 frames with description\n"
 	     << "  -m, --lame-tag         print the lame tags of the files\n"
-	     << "  -M, --lame-tag-crc     same as -m, but verify CRC checksums (slower)\n\n"
+	     << "  -M, --lame-tag-crc     same as -m, but verify CRC checksums (slower)\n"
+	     << "      --fields LIST      only show the comma separated id3v2 frame ids\n"
+	     << "                         and -i,-m field names (as used by --format=json,\n"
+	     << "                         with text output only for id3v2 frames) in LIST,\n"
+	     << "                         implies -i,-l,-m according to the fields\n"
+	     << "      --format FORMAT    output format of -i,-l,-m: text (default) or json,\n"
+	     << "                         which writes one json object per line and file\n"
+	     << "      --stats-report     print aggregate statistics of all the files\n"
+	     << "                         (genres, tag versions, bitrates, sample rates,\n"
+	     << "                         lame encoders, tag sizes, pictures, missing frames)\n"
+	     << "      --audio-hash       find the files with identical audio data by\n"
+	     << "                         hashing it without the tags, print the sets of\n"
+	     << "                         duplicates and the frames their tags differ in\n"
+	     << "      --where EXPR       only process the files matching EXPR, e.g.\n"
+	     << "                         'TPE2 = \"\" && TCON = 17' or 'APIC.size > 1M',\n"
+	     << "                         print their names if no other action is given\n"
+	     << "                         (for the syntax see below)\n"
+	     << "      --export FILE      write one row per file with path, size, the main\n"
+	     << "                         frames, audio properties and lame encoder/gains\n"
+	     << "                         to FILE ('-' for stdout), after all modifications\n"
+	     << "      --export-format FORMAT\n"
+	     << "                         format of --export: tsv (default) or columns,\n"
+	     << "                         a compact binary format with dictionary encoded\n"
+	     << "                         strings (see exporter.h)\n\n"
 	     << "To remove tags & specify which tag version(s) to write:\n"
 	     << "  -r, --remove FID       remove all id3v2 frames with the given frame id\n"
 	     << "  -D, --delete-all       delete both id3v1 and id3v2 tag\n"
@@ -253,7 +508,29 @@ void Options::printUsage() {
 	     << "                         convert v2 to v1 tag if file has no id3v1 tag\n"
 	     << "  -2                     same as -1, but vice versa\n"
 	     << "  -3                     write both id3v1 and id3v2 tag,\n"
-	     << "                         create and convert non-existing tags\n\n";
+	     << "                         create and convert non-existing tags\n"
+	     << "      --compact          remove duplicate id3v2 frames and excessive padding\n"
+	     << "      --safe-write       modify a copy of every file and let it replace the\n"
+	     << "                         original only when it is completely written to disk\n"
+	     << "      --journal FILE     append the original tags and times of every file to\n"
+	     << "                         FILE, before it is modified\n"
+	     << "      --rollback FILE    restore the tags and times saved in the journal FILE\n"
+	     << "                         (no <FILES> needed)\n"
+	     << "      --dump-tags PACK   save the raw tags of all the files in PACK, together\n"
+	     << "                         with the size and a hash of their audio data\n"
+	     << "      --load-tags PACK   replace the tags of the files with the ones saved in\n"
+	     << "                         PACK for the same path (if the size of the audio\n"
+	     << "                         data matches) or otherwise for the same audio data\n\n";
+	cout << "Tag profiles:\n"
+	     << "      --save-profile FILE\n"
+	     << "                         save the frames given as --FID options to FILE\n"
+	     << "                         (no <FILES> needed)\n"
+	     << "      --profile FILE     add the frames saved in FILE to the files, replacing\n"
+	     << "                         the frames with the same id/description;\n"
+	     << "                         frames given by other options are applied on top\n"
+	     << "      --copy-tags-from FILE\n"
+	     << "                         replace the tags of the files with the ones of the\n"
+	     << "                         mp3 file FILE, other options are applied on top\n\n";
 	cout << "Filename <-> tag information:\n"
 	     << "  -n, --file-pattern PATTERN\n"
 	     << "                         extract tag information from the given filenames,\n"
@@ -263,11 +540,32 @@ void Options::printUsage() {
 	     << "  -o, --organize PATTERN organize files into directory structure specified\n"
 	     << "                         by PATTERN (for supported wildcards see below)\n"
 	     << "  -x, --extract-apics    extract attached pictures as FILENAME.apic-NUM.FORMAT\n"
+	     << "      --apic-store DIR\n"
+	     << "                         same as -x, but save every distinct picture only once\n"
+	     << "                         in DIR, named by its hash, and hardlink the above\n"
+	     << "                         filenames to it (or list them in DIR/manifest)\n"
+	     << "      --sidecar-covers   move attached pictures to cover[-NUM].FORMAT files\n"
+	     << "                         next to the files, saving every picture only once\n"
 	     << "  -f, --force            overwrite existing files without asking (-o,-x)\n"
-	     << "      --move             when using -o, move files instead of copying them\n\n";
+	     << "      --move             when using -o, move files instead of copying them\n"
+	     << "      --link             when using -o, hardlink files instead of copying\n"
+	     << "                         them (copy them, if not on the same filesystem)\n"
+	     << "      --symlink          when using -o, create symlinks to the files\n"
+	     << "      --conflict POLICY  plan -o for all files before copying/moving any,\n"
+	     << "                         POLICY tells what to do if a target already exists\n"
+	     << "                         or is used by several files: suffix (append \" (N)\"),\n"
+	     << "                         skip or overwrite (only the first of several files\n"
+	     << "                         with the same target is organized), default: ask\n"
+	     << "      --jobs N           when using -o, copy up to N files at once in the\n"
+	     << "                         background, while the next files are processed;\n"
+	     << "                         with --rollback, restore N files at once\n\n";
 	cout << "The following wildcards are supported for the -o,-n,-N option arguments:\n"
 	     << "    %a: Artist, %A: album, %t: title, %g: genre, %y: year,\n"
-	     << "    %d: disc number, %T: track number, %%: percent sign\n\n"
+	     << "    %d: disc number, %T: track number, %%: percent sign\n"
+	     << "-o additionally supports:\n"
+	     << "    %{FID}: text of the frame FID, %{TXXX:DESC}: frame with description,\n"
+	     << "    %{FID|FID|\"text\"}: the first non-empty frame or the quoted text,\n"
+	     << "    a printf-like width for all wildcards, e.g. %03T, %-20{TIT2}\n\n"
 	     << "You can add and modify almost any id3v2 frame by using its 4-letter frame id\n"
 	     << "as a long option and the value to apply as the option argument.\n"
 	     << "Use --frame-list to get a list of supported frames (marked with *).\n"
@@ -277,22 +575,52 @@ void Options::printUsage() {
 	     << "      --TXXX TEXT" << FIELD_DELIM << "DESCRIPTION\n"
 	     << "      --USLT LYRICS[" << FIELD_DELIM << "DESCRIPTION[" << FIELD_DELIM << "LANGUAGE]]\n"
 	     << "      --WXXX URL[" << FIELD_DELIM << "DESCRIPTION]\n"
-	     << "Fields in square brackets are optional, LANGUAGE is an ISO-639-2 3-byte code." << endl;
+	     << "Fields in square brackets are optional, LANGUAGE is an ISO-639-2 3-byte code.\n\n"
+	     << "--where expressions combine tests with &&, ||, ! and parentheses.\n"
+	     << "A test is a field, optionally compared with =, !=, <, <=, >, >= or ~\n"
+	     << "(case-insensitive substring) to a number (with K/M/G suffix) or text.\n"
+	     << "Fields: FID (the text of the first such frame), FID.count, FID.size,\n"
+	     << "        size, bitrate, sample_rate, length\n"
+	     << "A field without comparison tests, if it is non-empty/non-zero." << endl;
 }
 
 int Options::tagsToWrite = 0;
 int Options::tagsToStrip = 0;
 bool Options::writeFile = false;
 bool Options::extractAPICs = false;
+const char *Options::apicStore = NULL;
+bool Options::extractOnly = false;
+bool Options::sidecarCovers = false;
+bool Options::compact = false;
+bool Options::safeWrite = false;
+const char *Options::journalPath = NULL;
+const char *Options::rollbackPath = NULL;
+const char *Options::dumpPath = NULL;
+bool Options::dumpOnly = false;
+const char *Options::loadPath = NULL;
+bool Options::loadOnly = false;
 bool Options::showInfo = false;
 bool Options::listTags = false;
 bool Options::listV2WithDesc = false;
 bool Options::printLameTag = false;
 bool Options::checkLameCRC = false;
+OutputFormat Options::outputFormat = FORMAT_TEXT;
+FieldList Options::fields;
+bool Options::scanOnly = false;
+const char *Options::exportPath = NULL;
+ExportFormat Options::exportFormat = EXPORT_TSV;
+bool Options::statsReport = false;
+bool Options::audioHash = false;
+Query Options::query;
+bool Options::printMatches = false;
 bool Options::forceOverwrite = false;
 char Options::fieldDelimiter = FIELD_DELIM;
 bool Options::preserveTimes = false;
 bool Options::moveFiles = false;
+bool Options::linkFiles = false;
+bool Options::symlinkFiles = false;
+ConflictPolicy Options::conflictPolicy = CONFLICT_ASK;
+uint Options::copyJobs = 1;
 bool Options::filenameToTag = false;
 IPattern Options::inPattern;
 bool Options::organize = false;
@@ -300,6 +628,12 @@ OPattern Options::outPattern;
 vector<GenericInfo*> Options::genericMods;
 vector<char*> Options::framesToRemove;
 vector<FrameInfo*> Options::framesToModify;
+bool Options::applyProfile = false;
+TagProfile Options::profile;
+bool Options::spliceProfile = false;
+const char *Options::saveProfile = NULL;
+bool Options::copyTags = false;
+TagProfile Options::sourceTag;
 uint Options::fileCount = 0;
 char **Options::filenames = NULL;
 
@@ -326,6 +660,13 @@ const struct option Options::longOptions[] = {
   { "list-wd",        no_argument,       NULL, 'L' },
   { "lame-tag",       no_argument,       NULL, 'm' },
   { "lame-tag-crc",   no_argument,       NULL, 'M' },
+  { "format",         required_argument, NULL, OPT_LO_FORMAT },
+  { "fields",         required_argument, NULL, OPT_LO_FIELDS },
+  { "stats-report",   no_argument,       NULL, OPT_LO_STATS },
+  { "audio-hash",     no_argument,       NULL, OPT_LO_AUDIO_HASH },
+  { "where",          required_argument, NULL, OPT_LO_WHERE },
+  { "export",         required_argument, NULL, OPT_LO_EXPORT },
+  { "export-format",  required_argument, NULL, OPT_LO_EXPORT_FORMAT },
   /* Remove tags & specify which versions to write */
   { "remove",         required_argument, NULL, 'r' },
   { "delete-all",     no_argument,       NULL, 'D' },
@@ -334,13 +675,29 @@ const struct option Options::longOptions[] = {
   { "",               no_argument,       NULL, '1' },
   { "",               no_argument,       NULL, '2' },
   { "",               no_argument,       NULL, '3' },
+  { "compact",        no_argument,       NULL, OPT_LO_COMPACT },
+  { "safe-write",     no_argument,       NULL, OPT_LO_SAFE_WRITE },
+  { "journal",        required_argument, NULL, OPT_LO_JOURNAL },
+  { "rollback",       required_argument, NULL, OPT_LO_ROLLBACK },
+  { "dump-tags",      required_argument, NULL, OPT_LO_DUMP_TAGS },
+  { "load-tags",      required_argument, NULL, OPT_LO_LOAD_TAGS },
+  /* tag profiles */
+  { "profile",        required_argument, NULL, OPT_LO_PROFILE },
+  { "save-profile",   required_argument, NULL, OPT_LO_SAVE_PROFILE },
+  { "copy-tags-from", required_argument, NULL, OPT_LO_COPY_TAGS },
 	/* Filename <-> tag information */
   { "file-pattern",   required_argument, NULL, 'n' },
   { "file-regex",     required_argument, NULL, 'N' },
   { "organize",       required_argument, NULL, 'o' },
   { "extract-apics",  no_argument,       NULL, 'x' },
+  { "apic-store",     required_argument, NULL, OPT_LO_APIC_STORE },
+  { "sidecar-covers", no_argument,       NULL, OPT_LO_SIDECAR },
   { "force",          no_argument,       NULL, 'f' },
   { "move",           no_argument,       NULL, OPT_LO_ORG_MOVE },
+  { "link",           no_argument,       NULL, OPT_LO_ORG_LINK },
+  { "symlink",        no_argument,       NULL, OPT_LO_ORG_SYMLINK },
+  { "conflict",       required_argument, NULL, OPT_LO_CONFLICT },
+  { "jobs",           required_argument, NULL, OPT_LO_JOBS },
   /* id3v2 frame ids for direct tagging */
 //{ "AENC", required_argument, &Options::optFrameID, FID3_AENC },
   { "APIC", required_argument, &Options::optFrameID, FID3_APIC },
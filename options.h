@@ -25,14 +25,64 @@
 #include <taglib/id3v2frame.h>
 
 #include "id3ted.h"
+#include "exporter.h"
+#include "fieldlist.h"
 #include "frameinfo.h"
 #include "genericinfo.h"
+#include "organizer.h"
 #include "pattern.h"
+#include "query.h"
+#include "tagprofile.h"
 
 enum LongOptOnly {
 	OPT_LO_FRAME_LIST = 128,
 	OPT_LO_GENRE_LIST,
-	OPT_LO_ORG_MOVE
+	OPT_LO_ORG_MOVE,
+	OPT_LO_ORG_LINK,
+	OPT_LO_ORG_SYMLINK,
+	OPT_LO_APIC_STORE,
+	OPT_LO_SIDECAR,
+	OPT_LO_COMPACT,
+	OPT_LO_SAFE_WRITE,
+	OPT_LO_JOURNAL,
+	OPT_LO_ROLLBACK,
+	OPT_LO_DUMP_TAGS,
+	OPT_LO_LOAD_TAGS,
+	OPT_LO_PROFILE,
+	OPT_LO_SAVE_PROFILE,
+	OPT_LO_COPY_TAGS,
+	OPT_LO_FORMAT,
+	OPT_LO_FIELDS,
+	OPT_LO_EXPORT,
+	OPT_LO_EXPORT_FORMAT,
+	OPT_LO_WHERE,
+	OPT_LO_STATS,
+	OPT_LO_AUDIO_HASH,
+	OPT_LO_CONFLICT,
+	OPT_LO_JOBS
+};
+
+enum OutputFormat {
+	FORMAT_TEXT,
+	FORMAT_JSON
+};
+
+/* the actions, which can be requested on the command line */
+enum Action {
+	ACTION_WRITE    = 1 << 0,
+	ACTION_COMPACT  = 1 << 1,
+	ACTION_SIDECAR  = 1 << 2,
+	ACTION_INFO     = 1 << 3,
+	ACTION_LIST     = 1 << 4,
+	ACTION_LAME     = 1 << 5,
+	ACTION_EXTRACT  = 1 << 6,
+	ACTION_ORGANIZE = 1 << 7,
+	ACTION_EXPORT   = 1 << 8,
+	ACTION_STATS    = 1 << 9,
+	ACTION_HASH     = 1 << 10,
+	ACTION_QUERY    = 1 << 11,
+	ACTION_DUMP     = 1 << 12,
+	ACTION_LOAD     = 1 << 13
 };
 
 class Options {
@@ -41,15 +91,39 @@ class Options {
 		static int tagsToStrip;                   // -[sSD]
 		static bool writeFile;                    // -[123sSDaAtcgTy]
 		static bool extractAPICs;                 // -x
+		static const char *apicStore;             // --apic-store
+		static bool extractOnly;                  // -x without other actions
+		static bool sidecarCovers;                // --sidecar-covers
+		static bool compact;                      // --compact
+		static bool safeWrite;                    // --safe-write
+		static const char *journalPath;           // --journal
+		static const char *rollbackPath;          // --rollback
+		static const char *dumpPath;              // --dump-tags
+		static bool dumpOnly;                     // --dump-tags without others
+		static const char *loadPath;              // --load-tags
+		static bool loadOnly;                     // --load-tags without others
 		static bool showInfo;                     // -i
 		static bool listTags;                     // -[lL]
 		static bool listV2WithDesc;               // -L
 		static bool printLameTag;                 // -[mM]
 		static bool checkLameCRC;                 // -M
+		static OutputFormat outputFormat;         // --format
+		static FieldList fields;                  // --fields
+		static bool scanOnly;                     // -l --fields without others
+		static const char *exportPath;            // --export
+		static ExportFormat exportFormat;         // --export-format
+		static bool statsReport;                  // --stats-report
+		static bool audioHash;                    // --audio-hash
+		static Query query;                       // --where
+		static bool printMatches;                 // --where without others
 		static bool forceOverwrite;               // -f
 		static char fieldDelimiter;               // -d
 		static bool preserveTimes;                // -p
 		static bool moveFiles;                    // --move
+		static bool linkFiles;                    // --link
+		static bool symlinkFiles;                 // --symlink
+		static ConflictPolicy conflictPolicy;     // --conflict
+		static uint copyJobs;                     // --jobs
 		static bool filenameToTag;                // -[nN]
 		static IPattern inPattern;                // -[nN]
 		static bool organize;                     // -o
@@ -57,6 +131,12 @@ class Options {
 		static vector<GenericInfo*> genericMods;  // -[aAtcgTy]
 		static vector<char*> framesToRemove;      // -r
 		static vector<FrameInfo*> framesToModify; // --FID
+		static bool applyProfile;                 // --profile
+		static TagProfile profile;                // --profile
+		static bool spliceProfile;                // --profile without later reads
+		static const char *saveProfile;           // --save-profile
+		static bool copyTags;                     // --copy-tags-from
+		static TagProfile sourceTag;              // --copy-tags-from
 
 		static uint fileCount;
 		static char **filenames;
@@ -69,6 +149,9 @@ class Options {
 		static const char *options;
 		static const struct option longOptions[];
 		static int optFrameID;
+
+		static uint actions();
+		static bool removesFrames();
 };
 
 #endif /* OPTIONS_H */
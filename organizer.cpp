@@ -0,0 +1,283 @@
+/* id3ted: organizer.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "organizer.h"
+#include "options.h"
+
+void Organizer::add(const char *source, const string &target,
+                    const FileTimes *times) {
+	Task task;
+	struct stat stats;
+
+	task.source = source;
+	task.target = String(target, DEF_TSTR_ENC).stripWhiteSpace().toCString(USE_UTF8);
+	task.preserveTimes = times != NULL;
+	if (times != NULL)
+		task.times = *times;
+	task.overwrite = false;
+	task.temporary = false;
+	task.state = PENDING;
+
+	if (stat(source, &stats) == 0) {
+		task.device = stats.st_dev;
+		task.inode = stats.st_ino;
+		sources.insert(make_pair(FileID(task.device, task.inode), tasks.size()));
+	} else {
+		task.device = 0;
+		task.inode = 0;
+	}
+
+	tasks.push_back(task);
+}
+
+bool Organizer::execute() {
+	set<string> directories;
+	bool success = true;
+	uint i;
+
+	plan();
+
+	for (i = 0; i < tasks.size(); ++i) {
+		if (tasks[i].state == PENDING)
+			directories.insert(directory(tasks[i].target));
+	}
+	set<string>::const_iterator dir = directories.begin();
+	for (; dir != directories.end(); ++dir) {
+		if (!dir->empty() && FileIO::createDir(dir->c_str()) != FileIO::Success)
+			success = false;
+	}
+
+	for (i = 0; i < tasks.size(); ++i) {
+		if (tasks[i].state == PENDING && !run(i))
+			success = false;
+	}
+
+	return success;
+}
+
+/* resolve all the conflicts before touching any file */
+void Organizer::plan() {
+	bool changed = true;
+	uint i;
+
+	for (i = 0; i < tasks.size(); ++i) {
+		if (sourceAt(tasks[i].target) == (int) i)
+			// already there
+			tasks[i].state = DONE;
+		else
+			resolve(i);
+	}
+
+	// the source of a skipped task stays where it is: a target, which was
+	// free because it gets moved away or which was going to be overwritten
+	// after being copied, is not
+	while (changed) {
+		changed = false;
+		for (i = 0; i < tasks.size(); ++i) {
+			if (tasks[i].state != PENDING)
+				continue;
+			int j = sourceAt(tasks[i].target);
+			if (j >= 0 && j != (int) i && tasks[j].state == SKIPPED) {
+				targets.erase(tasks[i].target);
+				tasks[i].overwrite = false;
+				resolve(i);
+				changed = true;
+			}
+		}
+	}
+}
+
+/* find a free target for task i according to the policy and claim it */
+void Organizer::resolve(uint i) {
+	Task &task = tasks[i];
+	string target = task.target;
+
+	for (uint n = 2; !isFree(i); ++n) {
+		map<string, uint>::const_iterator claim = targets.find(task.target);
+		int j = sourceAt(task.target);
+
+		if (policy == CONFLICT_SUFFIX) {
+			task.target = suffixed(target, n);
+			continue;
+		}
+		if (policy == CONFLICT_OVERWRITE && claim == targets.end() &&
+				(j < 0 || tasks[j].state != SKIPPED)) {
+			task.overwrite = true;
+			break;
+		}
+
+		if (claim != targets.end())
+			warn("%s: Skipped, because %s is also the target of: %s",
+			     task.source.c_str(), task.target.c_str(),
+			     tasks[claim->second].source.c_str());
+		else
+			warn("%s: Skipped, because the target exists: %s",
+			     task.source.c_str(), task.target.c_str());
+		task.state = SKIPPED;
+		return;
+	}
+
+	targets[task.target] = i;
+}
+
+/* a target is free, if no other task has claimed it and it either doesn't
+ * exist or is the source of another task, which moves it away */
+bool Organizer::isFree(uint i) const {
+	const Task &task = tasks[i];
+	map<string, uint>::const_iterator claim = targets.find(task.target);
+
+	if (claim != targets.end() && claim->second != i)
+		return false;
+	if (!FileIO::exists(task.target.c_str()))
+		return true;
+
+	int j = sourceAt(task.target);
+	return Options::moveFiles && j >= 0 && j != (int) i &&
+	       tasks[j].state != SKIPPED;
+}
+
+/* the index of the task, whose source is the file at path, -1 if none */
+int Organizer::sourceAt(const string &path) const {
+	struct stat stats;
+
+	if (stat(path.c_str(), &stats) != 0)
+		return -1;
+
+	map<FileID, uint>::const_iterator source =
+			sources.find(FileID(stats.st_dev, stats.st_ino));
+	return source != sources.end() ? (int) source->second : -1;
+}
+
+/* the unfinished task, which has to read the target of task i first */
+int Organizer::blocker(uint i) const {
+	int j = sourceAt(tasks[i].target);
+
+	if (j < 0 || j == (int) i || tasks[j].temporary)
+		return -1;
+	if (tasks[j].state != PENDING && tasks[j].state != RUNNING)
+		return -1;
+	return j;
+}
+
+/* perform task i after all the tasks it depends on, using an explicit
+ * stack, because the chains of dependent tasks can be very long */
+bool Organizer::run(uint i) {
+	vector<uint> stack;
+	bool success = true;
+
+	tasks[i].state = RUNNING;
+	stack.push_back(i);
+
+	while (!stack.empty()) {
+		uint top = stack.back();
+		int j = blocker(top);
+
+		if (j >= 0 && tasks[j].state == PENDING) {
+			tasks[j].state = RUNNING;
+			stack.push_back(j);
+			continue;
+		}
+		if (j >= 0 && !breakCycle(j))
+			success = false;
+
+		if (!perform(top))
+			success = false;
+		stack.pop_back();
+	}
+
+	return success;
+}
+
+bool Organizer::perform(uint i) {
+	Task &task = tasks[i];
+	FileIO::Status ret;
+
+	task.state = DONE;
+
+	// the file at the target may still be copied by the copy engine
+	if (task.temporary || FileIO::exists(task.target.c_str()))
+		FileIO::waitCopies();
+
+	if (task.temporary) {
+		if (rename(task.source.c_str(), task.target.c_str()) != 0) {
+			warn("%s: Could not rename file to: %s", task.source.c_str(),
+			     task.target.c_str());
+			return false;
+		}
+		if (task.preserveTimes)
+			FileIO::resetTimes(task.target.c_str(), task.times);
+		return true;
+	}
+
+	ret = FileIO::copy(task.source.c_str(), task.target.c_str(),
+	                   task.overwrite ? FileIO::Always : FileIO::Never,
+	                   task.preserveTimes ? &task.times : NULL);
+	if (ret == FileIO::Error) {
+		warn("%s: Could not organize file", task.source.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* move/copy the source of task i out of the way, into a temporary file next
+ * to its target, which is renamed to the target at the end */
+bool Organizer::breakCycle(uint i) {
+	Task &task = tasks[i];
+	string temp;
+
+	for (uint n = 0; temp.empty() || FileIO::exists(temp.c_str()); ++n) {
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".id3ted-%d-%u", (int) getpid(), n);
+		temp = task.target + suffix;
+	}
+
+	if (FileIO::copy(task.source.c_str(), temp.c_str(), FileIO::Never) !=
+			FileIO::Success) {
+		warn("%s: Could not organize file", task.source.c_str());
+		task.state = DONE;
+		return false;
+	}
+	task.source = temp;
+	task.temporary = true;
+
+	return true;
+}
+
+/* "dir/name (n).ext" for "dir/name.ext" */
+string Organizer::suffixed(const string &path, uint n) {
+	string::size_type slash = path.rfind('/');
+	string::size_type dot = path.rfind('.');
+	char suffix[16];
+
+	snprintf(suffix, sizeof(suffix), " (%u)", n);
+	if (dot == string::npos || (slash != string::npos && dot < slash + 2) ||
+			dot == 0)
+		return path + suffix;
+	return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+string Organizer::directory(const string &path) {
+	string::size_type slash = path.rfind('/');
+
+	return slash != string::npos ? path.substr(0, slash) : string();
+}
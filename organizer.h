@@ -0,0 +1,86 @@
+/* id3ted: organizer.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef ORGANIZER_H
+#define ORGANIZER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+enum ConflictPolicy {
+	CONFLICT_ASK,        // organize file by file, ask before overwriting
+	CONFLICT_SUFFIX,     // add " (2)", " (3)", ... before the extension
+	CONFLICT_SKIP,
+	CONFLICT_OVERWRITE
+};
+
+/* organizes all files at once in two phases, used with --conflict:
+ * first all the target paths are collected with add() and every conflict
+ * (between the targets or with existing files) is resolved by the policy,
+ * then execute() creates the needed directories and copies/moves the
+ * files, without ever asking the user. if a target is the source of
+ * another file, that file is handled first; cycles (e.g. swapping two
+ * files) are broken with a temporary file. */
+class Organizer {
+	public:
+		explicit Organizer(ConflictPolicy _policy) : policy(_policy) {}
+
+		void add(const char*, const string&, const FileTimes*);
+		bool execute();
+
+	private:
+		enum State { PENDING, RUNNING, DONE, SKIPPED };
+
+		typedef struct {
+			string source;
+			string target;
+			FileTimes times;
+			bool preserveTimes;
+			bool overwrite;
+			bool temporary;  // source is a temporary copy, rename it
+			dev_t device;
+			ino_t inode;
+			State state;
+		} Task;
+
+		typedef pair<dev_t, ino_t> FileID;
+
+		ConflictPolicy policy;
+		vector<Task> tasks;
+		map<string, uint> targets;
+		map<FileID, uint> sources;
+
+		void plan();
+		void resolve(uint);
+		bool isFree(uint) const;
+		int sourceAt(const string&) const;
+		int blocker(uint) const;
+		bool run(uint);
+		bool perform(uint);
+		bool breakCycle(uint);
+
+		static string suffixed(const string&, uint);
+		static string directory(const string&);
+};
+
+#endif /* ORGANIZER_H */
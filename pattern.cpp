@@ -18,9 +18,13 @@
 
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <cctype>
 #include <cstring>
 
 #include "pattern.h"
+#include "frametable.h"
+#include "mp3file.h"
 
 uint Pattern::count() const {
 	if (status == 0)
@@ -42,17 +46,26 @@ bool Pattern::needsID3v2() const {
 	return false;
 }
 
-bool IPattern::setPattern(const char *text, bool isRE) {
+IPattern::~IPattern() {
+	if (status > 0 && isRE)
+		regfree(&regex);
+}
+
+bool IPattern::setPattern(const char *text, bool _isRE) {
 	uint i;
 	bool wildcardPresent = false;
-	char flag = isRE ? 'N' : 'n';
+	char flag = _isRE ? 'N' : 'n';
 	ostringstream tmp;
+	string literal;
 
-	if (status > 0)
+	if (status > 0 && isRE)
 		regfree(&regex);
+	isRE = _isRE;
 	ids.clear();
 	subs.clear();
 	matches.clear();
+	literals.clear();
+	digitWildcards.clear();
 	status = 0;
 
 	for (i = 0; i < strlen(text); ++i) {
@@ -69,6 +82,9 @@ bool IPattern::setPattern(const char *text, bool isRE) {
 				case 'g':
 					tmp << "(.+)";
 					subs.push_back(text[++i]);
+					literals.push_back(literal);
+					literal.clear();
+					digitWildcards.push_back(false);
 					wildcardPresent = true;
 					break;
 				case 'y':
@@ -76,14 +92,18 @@ bool IPattern::setPattern(const char *text, bool isRE) {
 				case 'd':
 					tmp << "([0-9]+)";
 					subs.push_back(text[++i]);
+					literals.push_back(literal);
+					literal.clear();
+					digitWildcards.push_back(true);
 					wildcardPresent = true;
 					break;
 				case '%':
 					tmp << '%';
+					literal += text[++i];
 					break;
 				default:
 					warn("-%c option ignored, because pattern contains invalid wildcard: %c%c",
-					     text[i], text[i+1]);
+					     flag, text[i], text[i+1]);
 					return false;
 			}
 		} else {
@@ -97,8 +117,10 @@ bool IPattern::setPattern(const char *text, bool isRE) {
 					subs.push_back(0);
 			}
 			tmp << text[i];
+			literal += text[i];
 		}
 	}
+	literals.push_back(literal);
 
 	if (!wildcardPresent) {
 		warn("-%c option ignored, because pattern does not contain any wildcard",
@@ -106,12 +128,15 @@ bool IPattern::setPattern(const char *text, bool isRE) {
 		return false;
 	}
 
-	pattern = tmp.str();
+	if (isRE) {
+		pattern = tmp.str();
 
-	if (regcomp(&regex, pattern.c_str(), REG_EXTENDED) ||
-			regex.re_nsub != subs.size()) {
-		warn("error compiling regex for pattern, -%c option ignored", flag);
-		return false;
+		if (regcomp(&regex, pattern.c_str(), REG_EXTENDED) ||
+				regex.re_nsub != subs.size()) {
+			warn("error compiling regex for pattern, -%c option ignored", flag);
+			return false;
+		}
+		pmatch.resize(subs.size() + 1);
 	}
 
 	status = 1;
@@ -123,14 +148,22 @@ uint IPattern::match(const char *filename) {
 	if (status == 0)
 		return 0;
 
-	string path(filename);
-	regmatch_t *pmatch = new regmatch_t[subs.size() + 1];
-
 	status = 1;
 	ids.clear();
+
+	if (!isRE) {
+		if (!matchSegments(filename)) {
+			warn("%s: pattern does not match filename", filename);
+			return 0;
+		}
+		ids = subs;
+		status = 2;
+		return matches.size();
+	}
+
 	matches.clear();
 
-	if (regexec(&regex, filename, subs.size() + 1, pmatch, 0)) {
+	if (regexec(&regex, filename, pmatch.size(), &pmatch[0], 0)) {
 		warn("%s: pattern does not match filename", filename);
 		return 0;
 	}
@@ -140,18 +173,141 @@ uint IPattern::match(const char *filename) {
 			if (pmatch[i].rm_so == -1 || pmatch[i].rm_eo == -1)
 				matches.push_back("");
 			else
-				matches.push_back(path.substr(pmatch[i].rm_so,
+				matches.push_back(string(filename + pmatch[i].rm_so,
 						pmatch[i].rm_eo - pmatch[i].rm_so));
 			ids.push_back(subs[i-1]);
 		}
 	}
 
 	status = 2;
-	delete [] pmatch;
 
 	return matches.size();
 }
 
+/* match a -n pattern against the whole filename without a regex, giving
+ * the same captures as the equivalent (unanchored) posix regex: the match
+ * starting leftmost and ending rightmost wins, then every wildcard from
+ * left to right gets the longest text that still allows this match. */
+bool IPattern::matchSegments(const char *filename) {
+	uint length = strlen(filename);
+	uint wildcards = digitWildcards.size();
+	uint start, pos;
+	long end = -1;
+
+	digitRun.resize(length + 1);
+	reach.resize(length + 1);
+	canFinish.resize((wildcards + 1) * (length + 1));
+
+	digitRun[length] = 0;
+	for (pos = length; pos > 0; --pos)
+		digitRun[pos-1] = isdigit(filename[pos-1]) ? digitRun[pos] + 1 : 0;
+
+	for (start = 0; start <= length; ++start) {
+		if (!literalAt(filename, length, start, literals[0]))
+			continue;
+		if ((end = matchEnd(filename, length, start)) >= 0)
+			break;
+		if (!digitWildcards[0])
+			// a later start can only shorten the first wildcard
+			return false;
+	}
+	if (end < 0)
+		return false;
+
+	computeCanFinish(filename, length, start + literals[0].length(), end);
+
+	matches.resize(wildcards);
+	pos = start + literals[0].length();
+	for (uint w = 0; w < wildcards; ++w) {
+		const string &literal = literals[w+1];
+		const char *finish = &canFinish[(w + 1) * (length + 1)];
+		uint last = digitWildcards[w] ? pos + digitRun[pos] : length;
+
+		for (; last > pos; --last) {
+			if (literalAt(filename, length, last, literal) &&
+					finish[last + literal.length()])
+				break;
+		}
+		matches[w].assign(filename + pos, last - pos);
+		pos = last + literal.length();
+	}
+
+	return true;
+}
+
+/* the rightmost end of a match starting at start (after the first literal),
+ * -1 if there is none. reach marks the positions the pattern can get to. */
+long IPattern::matchEnd(const char *filename, uint length, uint start) {
+	long pos;
+
+	long first = start + literals[0].length();
+
+	fill(reach.begin() + first, reach.end(), 0);
+	reach[first] = 1;
+
+	for (uint w = 0; w < digitWildcards.size(); ++w) {
+		const string &literal = literals[w+1];
+		long limit = -1;
+
+		// the wildcard ends after a reachable position, within the run of
+		// digits starting there for digit wildcards
+		for (pos = first; pos <= (long) length; ++pos) {
+			bool reachable = reach[pos];
+			reach[pos] = pos <= limit;
+			if (!reachable)
+				continue;
+			if (!digitWildcards[w])
+				limit = length;
+			else if (pos + (long) digitRun[pos] > limit)
+				limit = pos + digitRun[pos];
+		}
+
+		// followed by the literal
+		if (literal.empty())
+			continue;
+		for (pos = length; pos >= first; --pos) {
+			bool reachable = reach[pos] &&
+			                 literalAt(filename, length, pos, literal);
+			reach[pos] = 0;
+			if (reachable)
+				reach[pos + literal.length()] = 1;
+		}
+	}
+
+	for (pos = length; pos >= first && !reach[pos]; --pos);
+	return pos >= first ? pos : -1;
+}
+
+/* canFinish[w][pos]: the wildcards from w on (and their literals) can match
+ * the filename from pos up to exactly end, only computed for pos >= first */
+void IPattern::computeCanFinish(const char *filename, uint length, uint first,
+                                uint end) {
+	uint wildcards = digitWildcards.size();
+	char *finish = &canFinish[wildcards * (length + 1)];
+
+	for (uint pos = first; pos <= length; ++pos)
+		finish[pos] = pos == end;
+
+	for (uint w = wildcards; w > 0; --w) {
+		const string &literal = literals[w];
+		const char *next = finish;
+		long nearest = -1;
+
+		finish = &canFinish[(w - 1) * (length + 1)];
+		finish[length] = 0;
+		for (long pos = length - 1; pos >= (long) first; --pos) {
+			// nearest end of the wildcard after pos, which can be continued
+			if (literalAt(filename, length, pos + 1, literal) &&
+					next[pos + 1 + literal.length()])
+				nearest = pos + 1;
+			if (digitWildcards[w-1])
+				finish[pos] = nearest >= 0 && nearest <= pos + (long) digitRun[pos];
+			else
+				finish[pos] = nearest >= 0;
+		}
+	}
+}
+
 MatchInfo IPattern::getMatch(uint num) const {
 	MatchInfo info;
 
@@ -178,12 +334,12 @@ int IPattern::preBackslashCount(const char *str, uint pos) const {
 }
 
 bool OPattern::setPattern(const char *pattern) {
+	Segment segment;
 	uint i;
 	bool wildcardPresent = false;
 
 	ids.clear();
-	pos.clear();
-	len.clear();
+	segments.clear();
 	status = 0;
 
 	if (strlen(pattern) == 0)
@@ -194,45 +350,128 @@ bool OPattern::setPattern(const char *pattern) {
 		return false;
 	}
 
+	segment.id = 0;
+	segment.flag = 0;
+	segment.width = 0;
 	for (i = 0; i < strlen(pattern); ++i) {
-		if (pattern[i] == '%') {
-			if (i+1 >= strlen(pattern)) {
-				warn("-o option ignored, because pattern ends with an invalid character");
-				return false;
-			}
-			switch (pattern[i+1]) {
-				case 'a':
-				case 'A':
-				case 't':
-				case 'c':
-				case 'g':
-				case 'T':
-				case 'y':
-				case 'd':
-					ids.push_back(pattern[i+1]);
-					pos.push_back(i++);
-					len.push_back(2);
-					wildcardPresent = true;
-					break;
-				default:
-					warn("-o option ignored, because pattern contains invalid wildcard: %c%c",
-					     pattern[i], pattern[i+1]);
+		if (pattern[i] != '%') {
+			segment.text += pattern[i];
+			continue;
+		}
+		if (pattern[i+1] == '%') {
+			segment.text += pattern[++i];
+			continue;
+		}
+
+		if (!segment.text.empty())
+			segments.push_back(segment);
+		segment.text.clear();
+
+		uint start = i++;
+		if (pattern[i] == '0' || pattern[i] == '-')
+			segment.flag = pattern[i++];
+		for (; isdigit(pattern[i]); ++i)
+			segment.width = segment.width * 10 + pattern[i] - '0';
+
+		switch (pattern[i]) {
+			case 'a':
+			case 'A':
+			case 't':
+			case 'c':
+			case 'g':
+			case 'T':
+			case 'y':
+			case 'd':
+				segment.id = pattern[i];
+				break;
+			case '{': {
+				const char *close = strchr(pattern + i, '}');
+				if (close == NULL) {
+					warn("-o option ignored, because pattern contains unterminated wildcard: %s",
+					     pattern + start);
+					return false;
+				}
+				segment.id = '{';
+				if (!parseAlternatives(string(pattern + i + 1, close).c_str(), segment))
 					return false;
+				i = close - pattern;
+				break;
 			}
+			case '\0':
+				warn("-o option ignored, because pattern ends with an invalid character");
+				return false;
+			default:
+				warn("-o option ignored, because pattern contains invalid wildcard: %.*s",
+				     i - start + 1, pattern + start);
+				return false;
 		}
+
+		segments.push_back(segment);
+		ids.push_back(segment.id);
+		wildcardPresent = true;
+
+		segment.id = 0;
+		segment.alternatives.clear();
+		segment.flag = 0;
+		segment.width = 0;
 	}
+	if (!segment.text.empty())
+		segments.push_back(segment);
 
 	if (!wildcardPresent) {
 		warn("-o option ignored, because pattern does not contain any wildcard");
+		ids.clear();
+		segments.clear();
 		return false;
 	}
 
-	text = pattern;
 	status = 1;
 
 	return true;
 }
 
+/* parse the '|' separated list inside %{...}: frame ids, optionally followed
+ * by ':' and a description, and quoted default texts */
+bool OPattern::parseAlternatives(const char *list, Segment &segment) {
+	const char *end;
+
+	for (; *list != '\0'; list = *end != '\0' ? end + 1 : end) {
+		Alternative alternative;
+
+		if (*list == '"') {
+			end = strchr(list + 1, '"');
+			if (end == NULL || (end[1] != '|' && end[1] != '\0')) {
+				warn("-o option ignored, because of invalid default text in: %%{%s}",
+				     list);
+				return false;
+			}
+			alternative.text.assign(list + 1, end - list - 1);
+			++end;
+		} else {
+			for (end = list; *end != '\0' && *end != '|'; ++end);
+			string name(list, end - list);
+			string::size_type colon = name.find(':');
+			if (colon != string::npos) {
+				alternative.description = String(name.substr(colon + 1), String::UTF8);
+				name.erase(colon);
+			}
+			if (name.length() != 4 || FrameTable::frameID(name.c_str()) == FID3_XXXX) {
+				warn("-o option ignored, because pattern contains invalid frame id: %s",
+				     name.c_str());
+				return false;
+			}
+			alternative.frameID = ByteVector(name.data(), 4);
+		}
+		segment.alternatives.push_back(alternative);
+	}
+
+	if (segment.alternatives.empty()) {
+		warn("-o option ignored, because pattern contains empty wildcard: %%{}");
+		return false;
+	}
+	return true;
+}
+
 MatchInfo OPattern::getMatch(uint num) const {
 	MatchInfo info;
 
@@ -245,28 +484,71 @@ MatchInfo OPattern::getMatch(uint num) const {
 	return info;
 }
 
-void OPattern::setMatch(uint num, const MatchInfo &info) {
-	int diff;
-	uint newlen, oldlen;
+/* build the path for the given file in path, replacing the characters, which
+ * are special to the shell, with replaceChar */
+void OPattern::render(MP3File &file, string &path, char replaceChar) const {
+	MatchInfo info;
 
-	if (status < 1 || num >= ids.size())
+	path.clear();
+	if (status < 1)
 		return;
 
-	oldlen = len[num];
-	newlen = info.text.length();
-	diff = newlen - oldlen;
+	vector<Segment>::const_iterator segment = segments.begin();
+	for (; segment != segments.end(); ++segment) {
+		if (segment->id == 0) {
+			append(path, segment->text, replaceChar);
+			continue;
+		}
 
-	text.replace(pos[num], oldlen, info.text);
-	len[num] = newlen;
+		info.text.clear();
+		if (segment->id != '{') {
+			info.id = segment->id;
+			file.fill(info);
+		}
+		vector<Alternative>::const_iterator alt = segment->alternatives.begin();
+		for (; alt != segment->alternatives.end() && info.text.empty(); ++alt) {
+			if (alt->frameID.isEmpty())
+				info.text = alt->text;
+			else if (alt->description.isEmpty())
+				info.text = file.frameText(alt->frameID).toCString(USE_UTF8);
+			else
+				info.text = file.frameText(alt->frameID, alt->description)
+				                .toCString(USE_UTF8);
+		}
+		if (segment->width > 0)
+			format(info.text, segment->flag, segment->width);
+		append(path, info.text, replaceChar);
+	}
+}
 
-	vector<uint>::iterator each = pos.begin() + num + 1;
-	for (; each != pos.end(); ++each)
-		*each += diff;
+/* pad text to width like printf() does with the given flag: for '0' the
+ * leading number of text (e.g. 3 of 3/12) is zero-padded */
+void OPattern::format(string &text, char flag, uint width) {
+	string::size_type digits = 0;
+
+	if (flag == '0') {
+		for (; digits < text.length() && isdigit(text[digits]); ++digits);
+		if (digits > 0) {
+			text.erase(digits);
+			while (text.length() > 1 && text[0] == '0')
+				text.erase(0, 1);
+			if (text.length() < width)
+				text.insert(0, width - text.length(), '0');
+		}
+	} else if (text.length() < width) {
+		if (flag == '-')
+			text.append(width - text.length(), ' ');
+		else
+			text.insert(0, width - text.length(), ' ');
+	}
 }
 
-void OPattern::replaceSpecialChars(char replaceChar) {
-	size_t pos;
+void OPattern::append(string &path, const string &text, char replaceChar) {
+	string::size_type start = path.length();
 
-	while ((pos = text.find_first_of("*~")) != string::npos)
-		text[pos] = replaceChar;
+	path += text;
+	for (string::size_type i = start; i < path.length(); ++i) {
+		if (path[i] == '*' || path[i] == '~')
+			path[i] = replaceChar;
+	}
 }
@@ -19,10 +19,13 @@
 #ifndef PATTERN_H
 #define PATTERN_H
 
+#include <cstring>
 #include <string>
 #include <vector>
 #include <regex.h>
 
+#include <taglib/tbytevector.h>
+
 #include "id3ted.h"
 
 typedef struct {
@@ -45,31 +48,82 @@ class Pattern {
 
 class IPattern : public Pattern {
 	public:
+		IPattern() : isRE(false) {}
+		~IPattern();
+
 		bool setPattern(const char*, bool);
 		uint match(const char*);
 		MatchInfo getMatch(uint) const;
 
 	private:
-		string pattern;
-		regex_t regex;
+		bool isRE;
 		vector<char> subs;
 		vector<string> matches;
 
+		/* -N: the pattern is a regex */
+		string pattern;
+		regex_t regex;
+		vector<regmatch_t> pmatch;
+
+		/* -n: the pattern is compiled into the literal texts around the
+		 * wildcards, literals[i] precedes wildcard i, the last one ends the
+		 * pattern. wildcards match one or more arbitrary characters or
+		 * digits. the other vectors are scratch space for match(),
+		 * which only grows with the length of the filenames. */
+		vector<string> literals;
+		vector<char> digitWildcards;
+		vector<uint> digitRun;
+		vector<char> reach;
+		vector<char> canFinish;
+
+		bool matchSegments(const char*);
+		long matchEnd(const char*, uint, uint);
+		void computeCanFinish(const char*, uint, uint, uint);
+
+		static bool literalAt(const char *text, uint length, uint pos,
+		                      const string &literal) {
+			return literal.empty() || (pos + literal.length() <= length &&
+			       text[pos] == literal[0] &&
+			       memcmp(text + pos, literal.data(), literal.length()) == 0);
+		}
+
 		int preBackslashCount(const char*, uint) const;
 };
 
+class MP3File;
+
+/* the compiled -o pattern: a list of literal texts and wildcards, which is
+ * never changed after setPattern(). render() fills in the wildcards for a
+ * file, so the same pattern can be used for any number of files at once.
+ * besides the single character wildcards, %{FID[:DESC]|...|"default"}
+ * is replaced by the first non-empty frame of the list. all wildcards can
+ * be given a printf-like width and flag, e.g. %03T or %-20{TIT2}. */
 class OPattern : public Pattern {
 	public:
 		bool setPattern(const char*);
 		MatchInfo getMatch(uint) const;
-		void setMatch(uint, const MatchInfo&);
-		void replaceSpecialChars(char);
-		const string& getText() const { return text; }
+		void render(MP3File&, string&, char) const;
 
 	private:
-		string text;
-		vector<uint> pos;
-		vector<uint> len;
+		typedef struct {
+			ByteVector frameID;  // empty for a quoted default text
+			String description;
+			string text;
+		} Alternative;
+
+		typedef struct {
+			char id;             // 0 for literal text, '{' for %{...}
+			string text;
+			vector<Alternative> alternatives;
+			char flag;           // '0', '-' or 0, like in printf()
+			uint width;
+		} Segment;
+
+		vector<Segment> segments;
+
+		bool parseAlternatives(const char*, Segment&);
+		static void format(string&, char, uint);
+		static void append(string&, const string&, char);
 };
 
 #endif /* PATTERN_H */
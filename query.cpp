@@ -0,0 +1,376 @@
+/* id3ted: query.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include <taglib/id3v1genres.h>
+#include <taglib/mpegproperties.h>
+
+#include "query.h"
+#include "mp3file.h"
+
+/* compile an expression, several ones are combined with 'and' */
+bool Query::parse(const char *expr) {
+	int node;
+
+	pos = expr;
+	if ((node = parseOr()) < 0)
+		return false;
+
+	while (isspace(*pos))
+		++pos;
+	if (*pos != '\0') {
+		warn("--where: unexpected input: %s", pos);
+		return false;
+	}
+
+	root = root < 0 ? node : addNode(NODE_AND, root, node);
+	return true;
+}
+
+bool Query::matches(MP3File &file) const {
+	return root < 0 || evaluate(root, file);
+}
+
+int Query::parseOr() {
+	int left = parseAnd();
+
+	while (left >= 0 && (symbol("||") || keyword("or"))) {
+		int right = parseAnd();
+		left = right < 0 ? -1 : addNode(NODE_OR, left, right);
+	}
+	return left;
+}
+
+int Query::parseAnd() {
+	int left = parseNot();
+
+	while (left >= 0 && (symbol("&&") || keyword("and"))) {
+		int right = parseNot();
+		left = right < 0 ? -1 : addNode(NODE_AND, left, right);
+	}
+	return left;
+}
+
+int Query::parseNot() {
+	if (symbol("!") || keyword("not")) {
+		int node = parseNot();
+		return node < 0 ? -1 : addNode(NODE_NOT, node, -1);
+	}
+	if (symbol("(")) {
+		int node = parseOr();
+		if (node >= 0 && !symbol(")")) {
+			warn("--where: missing ')' at: %s", pos);
+			return -1;
+		}
+		return node;
+	}
+	return parseTest();
+}
+
+int Query::parseTest() {
+	Node node;
+
+	node.type = NODE_TEST;
+	node.left = node.right = -1;
+	node.op = OP_EXISTS;
+	node.number = 0;
+	node.numeric = false;
+
+	if (!parseField(node))
+		return -1;
+	if (parseOp(node) && !parseValue(node))
+		return -1;
+
+	if (node.field != FIELD_TEXT && node.op != OP_EXISTS &&
+			(node.op == OP_CONTAINS || !node.numeric)) {
+		warn("--where: invalid comparison for numeric field: %s", node.text.c_str());
+		return -1;
+	}
+	if (node.field == FIELD_TEXT && node.frameID == "TCON" && node.numeric &&
+			node.number >= 0 && node.number < 255) {
+		// genres are compared by name
+		node.text = ID3v1::genre(node.number).toCString(USE_UTF8);
+		node.numeric = false;
+	}
+
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+bool Query::parseField(Node &node) {
+	const char *start;
+	string name;
+
+	while (isspace(*pos))
+		++pos;
+	for (start = pos; isalnum(*pos) || *pos == '_' || *pos == '.'; ++pos);
+	name.assign(start, pos - start);
+
+	if (name == "size") {
+		node.field = FIELD_SIZE;
+	} else if (name == "bitrate") {
+		node.field = FIELD_BITRATE;
+	} else if (name == "sample_rate") {
+		node.field = FIELD_SAMPLE_RATE;
+	} else if (name == "length") {
+		node.field = FIELD_LENGTH;
+	} else if (name.length() >= 4 && isupper(name[0]) && isalnum(name[1]) &&
+			isalnum(name[2]) && isalnum(name[3]) &&
+			(name.length() == 4 || name.compare(4, string::npos, ".count") == 0 ||
+			 name.compare(4, string::npos, ".size") == 0)) {
+		node.frameID = ByteVector(name.data(), 4);
+		if (name.length() == 4)
+			node.field = FIELD_TEXT;
+		else if (name[5] == 'c')
+			node.field = FIELD_COUNT;
+		else
+			node.field = FIELD_FRAME_SIZE;
+	} else {
+		if (name.empty())
+			warn("--where: missing field at: %s", start);
+		else
+			warn("--where: unknown field: %s", name.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* returns false, if there is no comparison operator */
+bool Query::parseOp(Node &node) {
+	if (symbol("!="))
+		node.op = OP_NE;
+	else if (symbol("<="))
+		node.op = OP_LE;
+	else if (symbol(">="))
+		node.op = OP_GE;
+	else if (symbol("=="))
+		node.op = OP_EQ;
+	else if (symbol("="))
+		node.op = OP_EQ;
+	else if (symbol("<"))
+		node.op = OP_LT;
+	else if (symbol(">"))
+		node.op = OP_GT;
+	else if (symbol("~"))
+		node.op = OP_CONTAINS;
+	else
+		return false;
+
+	return true;
+}
+
+bool Query::parseValue(Node &node) {
+	const char *start;
+
+	while (isspace(*pos))
+		++pos;
+
+	if (*pos == '"' || *pos == '\'') {
+		char quote = *pos++;
+		for (start = pos; *pos != '\0' && *pos != quote; ++pos);
+		if (*pos == '\0') {
+			warn("--where: unterminated string: %s", start - 1);
+			return false;
+		}
+		node.text.assign(start, pos++ - start);
+		return true;
+	}
+
+	for (start = pos; *pos != '\0' && !isspace(*pos) &&
+	     strchr("()&|!<>=~", *pos) == NULL; ++pos);
+	if (pos == start) {
+		warn("--where: missing value at: %s", start);
+		return false;
+	}
+	node.text.assign(start, pos - start);
+	node.numeric = toNumber(node.text, node.number, true);
+
+	return true;
+}
+
+bool Query::keyword(const char *word) {
+	size_t len = strlen(word);
+
+	while (isspace(*pos))
+		++pos;
+	if (strncmp(pos, word, len) != 0 || isalnum(pos[len]) || pos[len] == '_')
+		return false;
+
+	pos += len;
+	return true;
+}
+
+bool Query::symbol(const char *sym) {
+	size_t len = strlen(sym);
+
+	while (isspace(*pos))
+		++pos;
+	if (strncmp(pos, sym, len) != 0)
+		return false;
+
+	pos += len;
+	return true;
+}
+
+int Query::addNode(NodeType type, int left, int right) {
+	Node node;
+
+	node.type = type;
+	node.left = left;
+	node.right = right;
+	node.field = FIELD_TEXT;
+	node.op = OP_EXISTS;
+	node.number = 0;
+	node.numeric = false;
+
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+bool Query::evaluate(int index, MP3File &file) const {
+	const Node &node = nodes[index];
+
+	switch (node.type) {
+		case NODE_AND:
+			return evaluate(node.left, file) && evaluate(node.right, file);
+		case NODE_OR:
+			return evaluate(node.left, file) || evaluate(node.right, file);
+		case NODE_NOT:
+			return !evaluate(node.left, file);
+		default:
+			return test(node, file);
+	}
+}
+
+bool Query::test(const Node &node, MP3File &file) const {
+	const MPEG::Properties *properties;
+	long number = 0;
+
+	switch (node.field) {
+		case FIELD_TEXT: {
+			string text = file.frameText(node.frameID).toCString(USE_UTF8);
+			if (node.op == OP_EXISTS)
+				return !text.empty();
+			if (node.op == OP_CONTAINS)
+				return contains(text, node.text);
+			if (node.numeric) {
+				// compare numerically, if the frame starts with a number
+				if (toNumber(text, number, false))
+					return compare(node.op, number, node.number);
+				if (node.op != OP_EQ && node.op != OP_NE)
+					return false;
+			}
+			return compare(node.op, text, node.text);
+		}
+		case FIELD_COUNT:
+			number = file.frameCount(node.frameID);
+			break;
+		case FIELD_FRAME_SIZE:
+			number = file.frameSize(node.frameID);
+			break;
+		case FIELD_SIZE:
+			number = file.size();
+			break;
+		default:
+			if ((properties = file.audioProperties()) == NULL)
+				return false;
+			if (node.field == FIELD_BITRATE)
+				number = properties->bitrate();
+			else if (node.field == FIELD_SAMPLE_RATE)
+				number = properties->sampleRate();
+			else
+				number = properties->length();
+			break;
+	}
+
+	if (node.op == OP_EXISTS)
+		return number != 0;
+	return compare(node.op, number, node.number);
+}
+
+/* parse a decimal number, optionally with a K/M/G suffix. if exact is
+ * false, trailing text is allowed (e.g. "3/12" in TRCK frames). */
+bool Query::toNumber(const string &text, long &number, bool exact) {
+	const char *start = text.c_str();
+	char *end;
+
+	if (!isdigit(*start) && !(*start == '-' && isdigit(start[1])))
+		return false;
+
+	number = strtol(start, &end, 10);
+	if (!exact)
+		return true;
+
+	switch (*end) {
+		case 'G':
+			number *= 1024;
+		case 'M':
+			number *= 1024;
+		case 'K':
+			number *= 1024;
+			++end;
+			break;
+	}
+	return *end == '\0';
+}
+
+bool Query::compare(Op op, long a, long b) {
+	switch (op) {
+		case OP_EQ: return a == b;
+		case OP_NE: return a != b;
+		case OP_LT: return a < b;
+		case OP_LE: return a <= b;
+		case OP_GT: return a > b;
+		case OP_GE: return a >= b;
+		default:    return false;
+	}
+}
+
+bool Query::compare(Op op, const string &a, const string &b) {
+	int cmp = a.compare(b);
+
+	switch (op) {
+		case OP_EQ: return cmp == 0;
+		case OP_NE: return cmp != 0;
+		case OP_LT: return cmp < 0;
+		case OP_LE: return cmp <= 0;
+		case OP_GT: return cmp > 0;
+		case OP_GE: return cmp >= 0;
+		default:    return false;
+	}
+}
+
+/* case-insensitive (for ascii letters) substring search */
+bool Query::contains(const string &text, const string &part) {
+	if (part.length() > text.length())
+		return false;
+
+	for (size_t i = 0; i + part.length() <= text.length(); ++i) {
+		size_t j = 0;
+		for (; j < part.length(); ++j) {
+			if (tolower((unsigned char) text[i+j]) != tolower((unsigned char) part[j]))
+				break;
+		}
+		if (j == part.length())
+			return true;
+	}
+	return false;
+}
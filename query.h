@@ -0,0 +1,98 @@
+/* id3ted: query.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <string>
+#include <vector>
+
+#include <taglib/tbytevector.h>
+
+#include "id3ted.h"
+
+class MP3File;
+
+/* a --where predicate, compiled into a tree once and evaluated for every
+ * file. the expression language:
+ *
+ *   expr  := and (('||' | 'or') and)*
+ *   and   := not (('&&' | 'and') not)*
+ *   not   := ('!' | 'not') not | '(' expr ')' | test
+ *   test  := field [('=' | '!=' | '<' | '<=' | '>' | '>=' | '~') value]
+ *   field := FID | FID.count | FID.size | size | bitrate | sample_rate | length
+ *   value := "text" | 'text' | word | number[K|M|G]
+ *
+ * FID is the text of the first frame with this id (falling back to the
+ * id3v1 tag), FID.count the number of these frames and FID.size the size
+ * of the largest one. a field without a comparison tests, if it is
+ * non-empty/non-zero. '~' is a case-insensitive substring match. */
+class Query {
+	public:
+		Query() : root(-1) {}
+
+		bool parse(const char*);
+
+		bool isEmpty() const { return root < 0; }
+		bool matches(MP3File&) const;
+
+	private:
+		enum NodeType { NODE_AND, NODE_OR, NODE_NOT, NODE_TEST };
+		enum Field {
+			FIELD_TEXT, FIELD_COUNT, FIELD_FRAME_SIZE,
+			FIELD_SIZE, FIELD_BITRATE, FIELD_SAMPLE_RATE, FIELD_LENGTH
+		};
+		enum Op { OP_EXISTS, OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_CONTAINS };
+
+		typedef struct {
+			NodeType type;
+			int left;
+			int right;
+			Field field;
+			ByteVector frameID;
+			Op op;
+			string text;
+			long number;
+			bool numeric;  // the value is a number
+		} Node;
+
+		vector<Node> nodes;
+		int root;
+		const char *pos;
+
+		int parseOr();
+		int parseAnd();
+		int parseNot();
+		int parseTest();
+		bool parseField(Node&);
+		bool parseOp(Node&);
+		bool parseValue(Node&);
+		bool keyword(const char*);
+		bool symbol(const char*);
+		int addNode(NodeType, int, int);
+
+		bool evaluate(int, MP3File&) const;
+		bool test(const Node&, MP3File&) const;
+
+		static bool toNumber(const string&, long&, bool);
+		static bool compare(Op, long, long);
+		static bool compare(Op, const string&, const string&);
+		static bool contains(const string&, const string&);
+};
+
+#endif /* QUERY_H */
@@ -0,0 +1,206 @@
+/* id3ted: rawtags.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rawtags.h"
+
+/* the sizes of the id3v2 tag at the beginning and the id3v1 tag at the end
+ * of the size bytes of fd, the tags are read, if id3v2/id3v1 aren't NULL */
+bool RawTags::read(int fd, long size, ByteVector *id3v2, long &id3v2Size,
+                   ByteVector *id3v1, long &id3v1Size) {
+	char header[10];
+
+	id3v2Size = 0;
+	id3v1Size = 0;
+
+	if (size >= 10) {
+		if (pread(fd, header, 10, 0) != 10)
+			return false;
+		if (memcmp(header, "ID3", 3) == 0 && (unsigned char) header[3] < 0xFF &&
+				!((header[6] | header[7] | header[8] | header[9]) & 0x80)) {
+			id3v2Size = 10 + ((header[6] & 0x7F) << 21 | (header[7] & 0x7F) << 14 |
+			                  (header[8] & 0x7F) << 7  | (header[9] & 0x7F));
+			if (header[5] & 0x10)
+				// footer present
+				id3v2Size += 10;
+			if (id3v2Size > size)
+				id3v2Size = 0;
+		}
+	}
+
+	if (size - id3v2Size >= 128) {
+		char tag[3];
+		if (pread(fd, tag, 3, size - 128) != 3)
+			return false;
+		if (memcmp(tag, "TAG", 3) == 0)
+			id3v1Size = 128;
+	}
+
+	if (id3v2 != NULL) {
+		id3v2->resize(id3v2Size);
+		if (id3v2Size > 0 && pread(fd, id3v2->data(), id3v2Size, 0) != id3v2Size)
+			return false;
+	}
+	if (id3v1 != NULL) {
+		id3v1->resize(id3v1Size);
+		if (id3v1Size > 0 &&
+				pread(fd, id3v1->data(), id3v1Size, size - 128) != id3v1Size)
+			return false;
+	}
+
+	return true;
+}
+
+/* replace the tags of file path with the given ones, in place if possible.
+ * returns Abort, if the size of its audio data is not audioSize. */
+FileIO::Status RawTags::replace(const char *path, const ByteVector &newID3v2,
+                                const ByteVector &id3v1, long audioSize) {
+	long id3v2Size, id3v1Size;
+	struct stat stats;
+	bool success;
+	int fd;
+
+	if ((fd = open(path, O_RDWR)) == -1 || fstat(fd, &stats) != 0) {
+		warn("%s: %s", path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return FileIO::Error;
+	}
+	if (!read(fd, stats.st_size, NULL, id3v2Size, NULL, id3v1Size)) {
+		warn("%s: Could not read file", path);
+		close(fd);
+		return FileIO::Error;
+	}
+
+	long audio = stats.st_size - id3v2Size - id3v1Size;
+	if (audio != audioSize) {
+		close(fd);
+		return FileIO::Abort;
+	}
+
+	ByteVector id3v2 = newID3v2;
+	if (id3v2.size() >= 10 && (long) id3v2.size() < id3v2Size &&
+			!(id3v2[5] & 0x10)) {
+		// fill the space of the current tag with padding
+		uint size = id3v2Size - 10;
+		id3v2.resize(id3v2Size, 0);
+		id3v2[6] = size >> 21 & 0x7F;
+		id3v2[7] = size >> 14 & 0x7F;
+		id3v2[8] = size >> 7 & 0x7F;
+		id3v2[9] = size & 0x7F;
+	}
+
+	if ((long) id3v2.size() != id3v2Size && stats.st_nlink == 1) {
+		// the audio data has to be moved
+		success = rewrite(path, fd, id3v2, id3v2Size, audio, id3v1);
+		close(fd);
+	} else {
+		long end = id3v2.size() + audio;
+		success = true;
+		if ((long) id3v2.size() != id3v2Size)
+			// renaming a new file would only replace one of the hardlinks
+			success = move(fd, id3v2Size, id3v2.size(), audio);
+		success = success && pwrite(fd, id3v2.data(), id3v2.size(), 0) ==
+		          (ssize_t) id3v2.size() &&
+		          pwrite(fd, id3v1.data(), id3v1.size(), end) ==
+		          (ssize_t) id3v1.size() &&
+		          ftruncate(fd, end + id3v1.size()) == 0;
+		success = close(fd) == 0 && success;
+		if (!success)
+			warn("%s: Could not write file", path);
+	}
+
+	return success ? FileIO::Success : FileIO::Error;
+}
+
+/* write file path anew with the given tags around its audio data, which is
+ * found at offset in fd, and let it replace the file */
+bool RawTags::rewrite(const char *path, int fd, const ByteVector &id3v2,
+                      long offset, long length, const ByteVector &id3v1) {
+	string temp = path;
+	struct stat stats;
+	char suffix[32];
+	int out;
+	bool success;
+
+	size_t lastSlash = temp.rfind('/');
+	temp.insert(lastSlash != string::npos ? lastSlash + 1 : 0, ".");
+	snprintf(suffix, sizeof(suffix), ".id3ted-%d", (int) getpid());
+	temp += suffix;
+
+	if (fstat(fd, &stats) != 0 ||
+			(out = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600)) == -1) {
+		warn("%s: %s", temp.c_str(), strerror(errno));
+		return false;
+	}
+
+	char *buffer = new char[COPY_BUF_SIZE];
+	success = write(out, id3v2.data(), id3v2.size()) == (ssize_t) id3v2.size();
+	while (success && length > 0) {
+		size_t blockSize = length < COPY_BUF_SIZE ? length : COPY_BUF_SIZE;
+		ssize_t cnt = pread(fd, buffer, blockSize, offset);
+		success = cnt > 0 && write(out, buffer, cnt) == cnt;
+		offset += cnt;
+		length -= cnt;
+	}
+	delete [] buffer;
+
+	success = success &&
+	          write(out, id3v1.data(), id3v1.size()) == (ssize_t) id3v1.size() &&
+	          fchmod(out, stats.st_mode & 07777) == 0;
+	if ((stats.st_uid != geteuid() || stats.st_gid != getegid()) &&
+			fchown(out, stats.st_uid, stats.st_gid) != 0)
+		success = false;
+	success = close(out) == 0 && success;
+
+	if (!success || rename(temp.c_str(), path) != 0) {
+		warn("%s: Could not write file", path);
+		unlink(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/* move length bytes in fd from offset from to offset to, blockwise from
+ * the end, if the data is moved backwards, so that no block is overwritten
+ * before it has been moved */
+bool RawTags::move(int fd, long from, long to, long length) {
+	char *buffer = new char[COPY_BUF_SIZE];
+	bool success = true;
+	long done = 0;
+
+	while (success && done < length) {
+		long blockSize = length - done < COPY_BUF_SIZE ?
+		                 length - done : COPY_BUF_SIZE;
+		long pos = to > from ? length - done - blockSize : done;
+		success = pread(fd, buffer, blockSize, from + pos) == blockSize &&
+		          pwrite(fd, buffer, blockSize, to + pos) == blockSize;
+		done += blockSize;
+	}
+	delete [] buffer;
+
+	return success;
+}
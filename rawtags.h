@@ -0,0 +1,42 @@
+/* id3ted: rawtags.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RAWTAGS_H
+#define RAWTAGS_H
+
+#include <taglib/tbytevector.h>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+/* reads and replaces the id3v2 tag at the beginning and the id3v1 tag at
+ * the end of a file as raw bytes, without parsing them, for restoring
+ * tags saved by --journal or --dump-tags. */
+class RawTags {
+	public:
+		static bool read(int, long, ByteVector*, long&, ByteVector*, long&);
+		static FileIO::Status replace(const char*, const ByteVector&,
+		                              const ByteVector&, long);
+
+	private:
+		static bool rewrite(const char*, int, const ByteVector&, long, long,
+		                    const ByteVector&);
+		static bool move(int, long, long, long);
+};
+
+#endif /* RAWTAGS_H */
@@ -0,0 +1,175 @@
+/* id3ted: safewriter.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+#include "safewriter.h"
+
+#if defined(__linux__) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 14))
+#define HAVE_SYNCFS
+#endif
+
+/* create the copy of path to modify, temp is set to its location.
+ * returns Abort if path has to be modified in place. */
+FileIO::Status SafeWriter::open(const char *path, string &temp) {
+	struct stat stats;
+	char suffix[32];
+	int in, out;
+	bool cloned = false;
+
+	if (stat(path, &stats) != 0) {
+		warn("%s: Could not stat file", path);
+		return FileIO::Error;
+	}
+	if (stats.st_nlink > 1) {
+		// renaming would only replace one of the links
+		warn("%s: Modified in place, because it has several hardlinks", path);
+		return FileIO::Abort;
+	}
+
+	temp = path;
+	size_t lastSlash = temp.rfind('/');
+	lastSlash = lastSlash != string::npos ? lastSlash + 1 : 0;
+	temp.insert(lastSlash, ".");
+	snprintf(suffix, sizeof(suffix), ".id3ted-%d", (int) getpid());
+	temp += suffix;
+
+	if ((in = ::open(path, O_RDONLY)) == -1) {
+		warn("%s: %s", path, strerror(errno));
+		return FileIO::Error;
+	}
+	if ((out = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600)) == -1) {
+		warn("%s: %s", temp.c_str(), strerror(errno));
+		close(in);
+		return FileIO::Error;
+	}
+
+#ifdef FICLONE
+	cloned = ioctl(out, FICLONE, in) == 0;
+#endif
+
+	bool error = fchmod(out, stats.st_mode & 07777) != 0;
+	if ((stats.st_uid != geteuid() || stats.st_gid != getegid()) &&
+			fchown(out, stats.st_uid, stats.st_gid) != 0)
+		error = true;
+	close(in);
+	close(out);
+
+	if (error) {
+		warn("%s: Could not keep the permissions of the file", path);
+		unlink(temp.c_str());
+		return FileIO::Error;
+	}
+	if (!cloned &&
+			FileIO::copyRange(path, 0, stats.st_size, temp.c_str()) != FileIO::Success)
+		return FileIO::Error;
+
+	return FileIO::Success;
+}
+
+void SafeWriter::discard(const string &temp) {
+	unlink(temp.c_str());
+}
+
+/* let the modified copy temp replace path, at the latest with flush() */
+bool SafeWriter::commit(const char *path, const string &temp) {
+	Pending file;
+
+	file.path = path;
+	file.temp = temp;
+	pending.push_back(file);
+
+	return pending.size() < SAFE_WRITE_BATCH || flush();
+}
+
+/* replace the originals with all the copies committed so far */
+bool SafeWriter::flush() {
+	map<dev_t, bool> synced;
+	set<string> directories;
+	bool success = true;
+
+	for (uint i = 0; i < pending.size(); ++i) {
+		Pending &file = pending[i];
+		struct stat stats;
+		int fd;
+		bool ok = false;
+
+		if ((fd = ::open(file.temp.c_str(), O_RDONLY)) != -1 &&
+				fstat(fd, &stats) == 0) {
+#ifdef HAVE_SYNCFS
+			// the whole filesystem at once
+			if (synced.find(stats.st_dev) == synced.end())
+				synced[stats.st_dev] = syncfs(fd) == 0;
+			ok = synced[stats.st_dev];
+#else
+			ok = fsync(fd) == 0;
+#endif
+		}
+		if (fd != -1)
+			close(fd);
+
+		if (!ok) {
+			warn("%s: Could not sync file, original kept", file.path.c_str());
+			discard(file.temp);
+			success = false;
+		} else if (rename(file.temp.c_str(), file.path.c_str()) != 0) {
+			warn("%s: Could not rename file to: %s", file.temp.c_str(),
+			     file.path.c_str());
+			discard(file.temp);
+			success = false;
+		} else {
+			size_t lastSlash = file.path.rfind('/');
+			directories.insert(lastSlash != string::npos ?
+			                   file.path.substr(0, lastSlash + 1) : ".");
+		}
+	}
+	pending.clear();
+
+	set<string>::const_iterator dir = directories.begin();
+	for (; dir != directories.end(); ++dir) {
+		if (!syncDirectory(*dir))
+			success = false;
+	}
+
+	return success;
+}
+
+bool SafeWriter::syncDirectory(const string &path) {
+	int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+	bool success = fd != -1 && fsync(fd) == 0;
+
+	if (fd != -1)
+		close(fd);
+	if (!success)
+		warn("%s: Could not sync directory", path.c_str());
+
+	return success;
+}
@@ -0,0 +1,51 @@
+/* id3ted: safewriter.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SAFEWRITER_H
+#define SAFEWRITER_H
+
+#include <string>
+#include <vector>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+/* lets files be modified crash-safe: a file is modified in a copy next to
+ * it (a reflink, where the filesystem supports it), which is then renamed
+ * over the original. the copies are committed in batches of up to
+ * SAFE_WRITE_BATCH files: their data is synced once per filesystem before
+ * they are renamed, and the renames are synced once per directory. */
+class SafeWriter {
+	public:
+		FileIO::Status open(const char*, string&);
+		void discard(const string&);
+		bool commit(const char*, const string&);
+		bool flush();
+
+		static bool syncDirectory(const string&);
+
+	private:
+		typedef struct {
+			string path;
+			string temp;
+		} Pending;
+
+		vector<Pending> pending;
+};
+
+#endif /* SAFEWRITER_H */
@@ -0,0 +1,199 @@
+/* id3ted: stats.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <taglib/mpegproperties.h>
+
+#include "stats.h"
+#include "mp3file.h"
+#include "writer.h"
+
+/* frames, which every file is expected to have */
+const char *Stats::keyFrames[] = { "TPE1", "TALB", "TIT2", "TRCK", "TCON" };
+
+Stats::Stats() : files(0), totalSize(0), apicFiles(0), apicFrames(0),
+		apicBytes(0) {
+	memset(missing, 0, sizeof(missing));
+}
+
+void Stats::add(MP3File &file) {
+	const MPEG::Properties *properties;
+	String text;
+	long tagSize, bucket;
+	uint apics;
+
+	++files;
+	totalSize += file.size();
+
+	text = file.frameText("TCON");
+	++genres[text.isEmpty() ? "none" : text.toCString(USE_UTF8)];
+
+	++versions[file.id3v2Version()];
+
+	if ((properties = file.audioProperties()) != NULL) {
+		++bitrates[properties->bitrate() / 32 * 32];
+		++sampleRates[properties->sampleRate()];
+	}
+
+	text = file.lameEncoder();
+	++encoders[text.isEmpty() ? "none" : text.toCString(USE_UTF8)];
+
+	bucket = 0;
+	if ((tagSize = file.id3v2Size()) > 0) {
+		// upper bound in KB, doubling from 1 KB on
+		for (bucket = 1; bucket * 1024 < tagSize; bucket *= 2);
+	}
+	++tagSizes[bucket];
+
+	if ((apics = file.frameCount("APIC")) > 0) {
+		++apicFiles;
+		apicFrames += apics;
+		apicBytes += file.frameBytes("APIC");
+	}
+
+	for (int i = 0; i < KEY_FRAMES; ++i) {
+		if (file.frameText(keyFrames[i]).isEmpty())
+			++missing[i];
+	}
+}
+
+void Stats::print() const {
+	Writer &out = Writer::out;
+
+	out << "files: " << files << ", ";
+	out.putSize(totalSize) << '\n';
+
+	printHistogram("id3v2 version", "version", versions);
+	printCounter("genre", genres);
+	printHistogram("bitrate", "bitrate", bitrates);
+	printHistogram("sample rate", "sample_rate", sampleRates);
+	printCounter("lame encoder", encoders);
+	printHistogram("id3v2 tag size", "tag_size", tagSizes);
+
+	out << "\nattached pictures: " << apicFrames << " in " << apicFiles
+	    << " files, ";
+	out.putSize(apicBytes) << '\n';
+
+	out << "\nmissing frames:\n";
+	for (int i = 0; i < KEY_FRAMES; ++i) {
+		out << "  ";
+		out.putPadded(keyFrames[i], 20) << missing[i] << '\n';
+	}
+}
+
+void Stats::write(JsonWriter &json) const {
+	json.beginObject();
+	json.key("files");
+	json.value((long) files);
+	json.key("size");
+	json.value((long) totalSize);
+	writeHistogram(json, "id3v2_version", "version", versions);
+	writeCounter(json, "genre", genres);
+	writeHistogram(json, "bitrate", "bitrate", bitrates);
+	writeHistogram(json, "sample_rate", "sample_rate", sampleRates);
+	writeCounter(json, "lame_encoder", encoders);
+	writeHistogram(json, "id3v2_tag_size", "tag_size", tagSizes);
+
+	json.key("apic");
+	json.beginObject();
+	json.key("files");
+	json.value((long) apicFiles);
+	json.key("frames");
+	json.value((long) apicFrames);
+	json.key("size");
+	json.value((long) apicBytes);
+	json.endObject();
+
+	json.key("missing");
+	json.beginObject();
+	for (int i = 0; i < KEY_FRAMES; ++i) {
+		json.key(keyFrames[i]);
+		json.value((long) missing[i]);
+	}
+	json.endObject();
+	json.endObject();
+}
+
+string Stats::bucketName(const char *kind, long key) {
+	char name[32];
+
+	if (strcmp(kind, "version") == 0) {
+		if (key == 0)
+			return "none";
+		snprintf(name, sizeof(name), "2.%ld", key);
+	} else if (strcmp(kind, "bitrate") == 0) {
+		snprintf(name, sizeof(name), "%ld-%ld kbps", key, key + 31);
+	} else if (strcmp(kind, "sample_rate") == 0) {
+		snprintf(name, sizeof(name), "%ld Hz", key);
+	} else {
+		if (key == 0)
+			return "none";
+		snprintf(name, sizeof(name), "<= %ld KB", key);
+	}
+	return name;
+}
+
+void Stats::printCounter(const char *title, const Counter &counter) {
+	Writer &out = Writer::out;
+
+	out << '\n' << title << ":\n";
+	Counter::const_iterator each = counter.begin();
+	for (; each != counter.end(); ++each) {
+		out << "  ";
+		out.putPadded(each->first.c_str(), 20) << each->second << '\n';
+	}
+}
+
+void Stats::printHistogram(const char *title, const char *kind,
+                           const Histogram &histogram) {
+	Writer &out = Writer::out;
+
+	out << '\n' << title << ":\n";
+	Histogram::const_iterator each = histogram.begin();
+	for (; each != histogram.end(); ++each) {
+		out << "  ";
+		out.putPadded(bucketName(kind, each->first).c_str(), 20)
+		    << each->second << '\n';
+	}
+}
+
+void Stats::writeCounter(JsonWriter &json, const char *name,
+                         const Counter &counter) {
+	json.key(name);
+	json.beginObject();
+	Counter::const_iterator each = counter.begin();
+	for (; each != counter.end(); ++each) {
+		json.key(each->first.c_str());
+		json.value((long) each->second);
+	}
+	json.endObject();
+}
+
+void Stats::writeHistogram(JsonWriter &json, const char *name,
+                           const char *kind, const Histogram &histogram) {
+	json.key(name);
+	json.beginObject();
+	Histogram::const_iterator each = histogram.begin();
+	for (; each != histogram.end(); ++each) {
+		json.key(bucketName(kind, each->first).c_str());
+		json.value((long) each->second);
+	}
+	json.endObject();
+}
@@ -0,0 +1,70 @@
+/* id3ted: stats.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <map>
+#include <string>
+
+#include "id3ted.h"
+#include "jsonwriter.h"
+
+class MP3File;
+
+/* aggregate counters for --stats-report, every file is counted with
+ * add() */
+class Stats {
+	public:
+		Stats();
+
+		void add(MP3File&);
+
+		void print() const;
+		void write(JsonWriter&) const;
+
+	private:
+		typedef map<string, unsigned long> Counter;
+		typedef map<long, unsigned long> Histogram;
+
+		enum { KEY_FRAMES = 5 };
+
+		unsigned long files;
+		unsigned long totalSize;
+		Counter genres;
+		Histogram versions;
+		Histogram bitrates;
+		Histogram sampleRates;
+		Counter encoders;
+		Histogram tagSizes;
+		unsigned long apicFiles;
+		unsigned long apicFrames;
+		unsigned long apicBytes;
+		unsigned long missing[KEY_FRAMES];
+
+		static const char *keyFrames[];
+
+		static string bucketName(const char*, long);
+		static void printCounter(const char*, const Counter&);
+		static void printHistogram(const char*, const char*, const Histogram&);
+		static void writeCounter(JsonWriter&, const char*, const Counter&);
+		static void writeHistogram(JsonWriter&, const char*, const char*,
+		                           const Histogram&);
+};
+
+#endif /* STATS_H */
@@ -0,0 +1,286 @@
+/* id3ted: tagpack.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tagpack.h"
+#include "hash.h"
+#include "rawtags.h"
+
+static const char MAGIC[] = "ID3TPAK\1";
+enum { HEADER_SIZE = 24, ENTRY_SIZE = 40 };
+
+TagPack::~TagPack() {
+	if (fd != -1)
+		close(fd);
+	if (data != NULL)
+		munmap((void*) data, size);
+}
+
+/* start writing a new pack to path */
+bool TagPack::create(const char *path) {
+	char header[HEADER_SIZE];
+
+	memset(header, 0, HEADER_SIZE);
+	memcpy(header, MAGIC, 8);
+
+	if ((fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1 ||
+			write(fd, header, HEADER_SIZE) != HEADER_SIZE) {
+		warn("%s: %s", path, strerror(errno));
+		return false;
+	}
+	offset = HEADER_SIZE;
+
+	return true;
+}
+
+/* append the tags of file path */
+bool TagPack::add(const char *path) {
+	ByteVector id3v2, id3v1;
+	long id3v2Size, id3v1Size;
+	struct stat stats;
+	Entry entry;
+	int in;
+
+	if ((in = ::open(path, O_RDONLY)) == -1 || fstat(in, &stats) != 0) {
+		warn("%s: %s", path, strerror(errno));
+		if (in != -1)
+			close(in);
+		return false;
+	}
+	bool success = RawTags::read(in, stats.st_size, &id3v2, id3v2Size, &id3v1,
+	                             id3v1Size);
+	close(in);
+	if (!success || !contentKey(path, entry.audioSize, entry.audioHash)) {
+		warn("%s: Could not read file", path);
+		return false;
+	}
+
+	ByteVector record(path, strlen(path));
+	record.append(id3v2);
+	record.append(id3v1);
+	if (write(fd, record.data(), record.size()) != (ssize_t) record.size()) {
+		warn("Could not write tag pack: %s", strerror(errno));
+		return false;
+	}
+
+	entry.offset = offset;
+	entry.pathLength = strlen(path);
+	entry.id3v2Length = id3v2.size();
+	entry.id3v1Length = id3v1.size();
+	index.push_back(entry);
+	offset += record.size();
+
+	return true;
+}
+
+/* write the index and complete the header */
+bool TagPack::finish() {
+	vector<char> buffer(index.size() * ENTRY_SIZE, 0);
+	char header[12];
+
+	if (fd == -1)
+		return true;
+
+	stable_sort(index.begin(), index.end(), keyLess);
+	for (uint i = 0; i < index.size(); ++i) {
+		char *pos = &buffer[0] + i * ENTRY_SIZE;
+		put(pos, index[i].offset, 8);
+		put(pos + 8, index[i].pathLength, 4);
+		put(pos + 12, index[i].id3v2Length, 4);
+		put(pos + 16, index[i].id3v1Length, 4);
+		put(pos + 24, index[i].audioSize, 8);
+		put(pos + 32, index[i].audioHash, 8);
+	}
+	put(header, offset, 8);
+	put(header + 8, index.size(), 4);
+
+	bool success = (buffer.empty() ||
+	                write(fd, &buffer[0], buffer.size()) == (ssize_t) buffer.size()) &&
+	               pwrite(fd, header, 12, 8) == 12 && fsync(fd) == 0;
+	success = close(fd) == 0 && success;
+	fd = -1;
+
+	if (!success)
+		warn("Could not write tag pack: %s", strerror(errno));
+	return success;
+}
+
+/* map the pack at path for loading tags from it */
+bool TagPack::open(const char *path) {
+	struct stat stats;
+	int in;
+
+	if ((in = ::open(path, O_RDONLY)) == -1 || fstat(in, &stats) != 0) {
+		warn("%s: %s", path, strerror(errno));
+		if (in != -1)
+			close(in);
+		return false;
+	}
+	size = stats.st_size;
+	if (size >= HEADER_SIZE) {
+		void *mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, in, 0);
+		if (mapped != MAP_FAILED)
+			data = (const char*) mapped;
+	}
+	close(in);
+
+	if (data == NULL || memcmp(data, MAGIC, 8) != 0) {
+		warn("%s: Not an id3ted tag pack", path);
+		return false;
+	}
+
+	uint64_t indexOffset = get(data + 8, 8);
+	count = get(data + 16, 4);
+	if (indexOffset < HEADER_SIZE || indexOffset > size ||
+			(size - indexOffset) / ENTRY_SIZE < count) {
+		warn("%s: Corrupt tag pack", path);
+		count = 0;
+		return false;
+	}
+
+	for (uint i = 0; i < count; ++i) {
+		Entry e = entry(i);
+		if (e.offset + e.pathLength + e.id3v2Length + e.id3v1Length > indexOffset) {
+			warn("%s: Corrupt tag pack", path);
+			count = 0;
+			return false;
+		}
+		paths.insert(make_pair(string(data + e.offset, e.pathLength), i));
+	}
+
+	return true;
+}
+
+/* put the tags saved for file path into the file at target, which is
+ * found by path, or by its content key, if the audio data of the file
+ * saved with this path differs */
+FileIO::Status TagPack::load(const char *path, const char *target) {
+	map<string, uint>::const_iterator byPath = paths.find(path);
+	uint64_t audioSize, audioHash;
+
+	if (byPath != paths.end()) {
+		FileIO::Status ret = apply(byPath->second, target);
+		if (ret != FileIO::Abort)
+			return ret;
+	}
+
+	if (!contentKey(target, audioSize, audioHash)) {
+		warn("%s: Could not read file", path);
+		return FileIO::Error;
+	}
+	int i = find(audioSize, audioHash);
+	if (i < 0) {
+		warn("%s: Not found in tag pack", path);
+		return FileIO::Abort;
+	}
+
+	return apply(i, target);
+}
+
+TagPack::Entry TagPack::entry(uint i) const {
+	const char *pos = data + get(data + 8, 8) + i * ENTRY_SIZE;
+	Entry e;
+
+	e.offset = get(pos, 8);
+	e.pathLength = get(pos + 8, 4);
+	e.id3v2Length = get(pos + 12, 4);
+	e.id3v1Length = get(pos + 16, 4);
+	e.audioSize = get(pos + 24, 8);
+	e.audioHash = get(pos + 32, 8);
+
+	return e;
+}
+
+/* binary search for the content key in the index */
+int TagPack::find(uint64_t audioSize, uint64_t audioHash) const {
+	uint low = 0, high = count;
+
+	while (low < high) {
+		uint mid = low + (high - low) / 2;
+		Entry e = entry(mid);
+		if (e.audioSize < audioSize ||
+				(e.audioSize == audioSize && e.audioHash < audioHash))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low < count) {
+		Entry e = entry(low);
+		if (e.audioSize == audioSize && e.audioHash == audioHash)
+			return low;
+	}
+
+	return -1;
+}
+
+FileIO::Status TagPack::apply(uint i, const char *target) const {
+	Entry e = entry(i);
+	const char *tags = data + e.offset + e.pathLength;
+
+	return RawTags::replace(target, ByteVector(tags, e.id3v2Length),
+	                        ByteVector(tags + e.id3v2Length, e.id3v1Length),
+	                        e.audioSize);
+}
+
+/* size and hash of the audio data of file path, i.e. without its tags */
+bool TagPack::contentKey(const char *path, uint64_t &audioSize,
+                         uint64_t &audioHash) {
+	long id3v2Size, id3v1Size;
+	struct stat stats;
+	int in;
+
+	if ((in = ::open(path, O_RDONLY)) == -1)
+		return false;
+	bool success = fstat(in, &stats) == 0 &&
+	               RawTags::read(in, stats.st_size, NULL, id3v2Size, NULL,
+	                             id3v1Size);
+	close(in);
+	if (!success)
+		return false;
+
+	IFile file(path);
+	audioSize = stats.st_size - id3v2Size - id3v1Size;
+	return file.isOpen() && Hash::of(file, id3v2Size, audioSize, audioHash);
+}
+
+bool TagPack::keyLess(const Entry &a, const Entry &b) {
+	return a.audioSize < b.audioSize ||
+	       (a.audioSize == b.audioSize && a.audioHash < b.audioHash);
+}
+
+void TagPack::put(char *pos, uint64_t value, uint bytes) {
+	for (uint i = bytes; i > 0; --i) {
+		pos[i - 1] = value & 0xFF;
+		value >>= 8;
+	}
+}
+
+uint64_t TagPack::get(const char *pos, uint bytes) {
+	uint64_t value = 0;
+
+	for (uint i = 0; i < bytes; ++i)
+		value = value << 8 | (unsigned char) pos[i];
+	return value;
+}
@@ -0,0 +1,84 @@
+/* id3ted: tagpack.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TAGPACK_H
+#define TAGPACK_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+/* pack of the raw tags of many files for --dump-tags/--load-tags, which
+ * can be restored by the path of a file or by its content key (the size
+ * and hash of its audio data).
+ *
+ * format (all numbers big-endian):
+ *   "ID3TPAK\1", uint64 offset of the index, uint32 number of files,
+ *   uint32 0, followed by path, id3v2 tag and id3v1 tag of every file,
+ *   followed by the index: an entry of 40 bytes per file
+ *     uint64 offset of the path, uint32 length of the path,
+ *     uint32 length of the id3v2 tag, uint32 length of the id3v1 tag,
+ *     uint32 0, uint64 size of the audio data, uint64 hash of it,
+ *   sorted by audio size and hash.
+ * the pack is written in one pass and read with mmap(). */
+class TagPack {
+	public:
+		TagPack() : fd(-1), offset(0), data(NULL), size(0), count(0) {}
+		~TagPack();
+
+		bool create(const char*);
+		bool add(const char*);
+		bool finish();
+
+		bool open(const char*);
+		FileIO::Status load(const char*, const char*);
+
+	private:
+		typedef struct {
+			uint64_t offset;
+			uint pathLength;
+			uint id3v2Length;
+			uint id3v1Length;
+			uint64_t audioSize;
+			uint64_t audioHash;
+		} Entry;
+
+		int fd;
+		uint64_t offset;
+		vector<Entry> index;
+
+		const char *data;
+		size_t size;
+		uint count;
+		map<string, uint> paths;
+
+		Entry entry(uint) const;
+		int find(uint64_t, uint64_t) const;
+		FileIO::Status apply(uint, const char*) const;
+
+		static bool contentKey(const char*, uint64_t&, uint64_t&);
+		static bool keyLess(const Entry&, const Entry&);
+		static void put(char*, uint64_t, uint);
+		static uint64_t get(const char*, uint);
+};
+
+#endif /* TAGPACK_H */
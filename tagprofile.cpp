@@ -0,0 +1,224 @@
+/* id3ted: tagprofile.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <taglib/mpegfile.h>
+#include <taglib/id3v1tag.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/id3v2header.h>
+#include <taglib/id3v2framefactory.h>
+
+#include "tagprofile.h"
+#include "fileio.h"
+
+TagProfile::~TagProfile() {
+	for (uint i = 0; i < parsed.size(); ++i)
+		delete parsed[i];
+}
+
+void TagProfile::add(ID3v2::Frame *frame) {
+	if (frame == NULL)
+		return;
+
+	frame->header()->setVersion(4);
+	ByteVector raw = frame->render();
+	if (raw.size() > ID3v2::Frame::headerSize(4)) {
+		data.append(raw);
+		++count;
+	}
+}
+
+bool TagProfile::add(const FrameInfo *info) {
+	ID3v2::Frame *frame = info->createFrame();
+
+	if (frame == NULL)
+		return false;
+
+	add(frame);
+	delete frame;
+
+	return true;
+}
+
+/* parse the pre-rendered data into new frame objects, which are owned by
+ * the caller; needed per file, if the profile can not be spliced */
+vector<ID3v2::Frame*> TagProfile::createFrames() const {
+	vector<ID3v2::Frame*> list;
+	ID3v2::Header header;
+	ID3v2::FrameFactory *factory = ID3v2::FrameFactory::instance();
+	uint headerSize = ID3v2::Frame::headerSize(4);
+	uint pos = 0;
+
+	header.setMajorVersion(4);
+
+	while (pos + headerSize <= data.size()) {
+		ID3v2::Frame::Header frameHeader(data.mid(pos, headerSize));
+		uint size = headerSize + frameHeader.frameSize();
+
+		ID3v2::Frame *frame = factory->createFrame(data.mid(pos, size), &header);
+		if (frame != NULL)
+			list.push_back(frame);
+		pos += size;
+	}
+
+	return list;
+}
+
+/* the i-th pre-rendered frame of the profile, as it is in the profile file */
+ByteVector TagProfile::rendered(uint i) const {
+	uint headerSize = ID3v2::Frame::headerSize(4);
+	ID3v2::Frame::Header frameHeader(data.mid(offsets[i], headerSize));
+
+	return data.mid(offsets[i], headerSize + frameHeader.frameSize());
+}
+
+/* parse the frames once and remember where they start in the pre-rendered
+ * data; only used for profiles, which are applied to many files */
+void TagProfile::index() {
+	ID3v2::Header header;
+	ID3v2::FrameFactory *factory = ID3v2::FrameFactory::instance();
+	uint headerSize = ID3v2::Frame::headerSize(4);
+	uint pos = 0;
+
+	for (uint i = 0; i < parsed.size(); ++i)
+		delete parsed[i];
+	parsed.clear();
+	offsets.clear();
+	header.setMajorVersion(4);
+
+	while (pos + headerSize <= data.size()) {
+		ID3v2::Frame::Header frameHeader(data.mid(pos, headerSize));
+		uint size = headerSize + frameHeader.frameSize();
+
+		ID3v2::Frame *frame = factory->createFrame(data.mid(pos, size), &header);
+		if (frame != NULL) {
+			offsets.push_back(pos);
+			parsed.push_back(frame);
+		}
+		pos += size;
+	}
+}
+
+/* take over the complete id3v2 tag of the given mp3 file, or the
+ * information of its id3v1 tag, if it has no id3v2 tag */
+bool TagProfile::copyFrom(const char *path) {
+	MPEG::File file(path, false);
+	ID3v1::Tag *id3v1Tag;
+	ID3v2::Tag *id3v2Tag;
+
+	if (!file.isValid()) {
+		warn("%s: Could not read tags", path);
+		return false;
+	}
+
+	data.clear();
+	count = 0;
+	id3v1Tag = file.ID3v1Tag();
+	id3v2Tag = file.ID3v2Tag();
+
+	if (id3v2Tag != NULL && !id3v2Tag->isEmpty()) {
+		ID3v2::FrameList::ConstIterator frame = id3v2Tag->frameList().begin();
+		for (; frame != id3v2Tag->frameList().end(); ++frame) {
+			// the frame should be discarded, if the tag is altered
+			if (!(*frame)->header()->tagAlterPreservation())
+				add(*frame);
+		}
+	} else if (id3v1Tag != NULL && !id3v1Tag->isEmpty()) {
+		ID3v2::Tag tag;
+		Tag::duplicate(id3v1Tag, &tag, true);
+
+		ID3v2::FrameList::ConstIterator frame = tag.frameList().begin();
+		for (; frame != tag.frameList().end(); ++frame)
+			add(*frame);
+	}
+	index();
+
+	return true;
+}
+
+bool TagProfile::load(const char *path) {
+	IFile file(path);
+	ByteVector tag;
+	uint headerSize = ID3v2::Frame::headerSize(4);
+	uint pos = 0;
+
+	if (!file.isOpen())
+		return false;
+
+	file.read(tag);
+	if (file.error()) {
+		warn("%s: Could not read file", path);
+		return false;
+	}
+
+	if (tag.size() < ID3v2::Header::size() ||
+			!tag.startsWith(ID3v2::Header::fileIdentifier())) {
+		warn("%s: Not a tag profile", path);
+		return false;
+	}
+
+	ID3v2::Header header(tag.mid(0, ID3v2::Header::size()));
+	if (header.majorVersion() != 4 || header.extendedHeader() ||
+			header.unsynchronisation()) {
+		warn("%s: Unsupported tag profile, only plain id3v2.4 tags are allowed",
+		     path);
+		return false;
+	}
+
+	data = tag.mid(ID3v2::Header::size(), header.tagSize());
+	count = 0;
+
+	while (pos + headerSize <= data.size() && data[pos] != 0) {
+		ID3v2::Frame::Header frameHeader(data.mid(pos, headerSize));
+		pos += headerSize + frameHeader.frameSize();
+		++count;
+	}
+	if (pos > data.size()) {
+		warn("%s: Corrupt tag profile", path);
+		data.clear();
+		count = 0;
+		return false;
+	}
+	// cut off the padding
+	data.resize(pos);
+	index();
+
+	return true;
+}
+
+bool TagProfile::save(const char *path) const {
+	ID3v2::Header header;
+	OFile file(path);
+
+	if (!file.isOpen())
+		return false;
+
+	header.setMajorVersion(4);
+	header.setTagSize(data.size());
+
+	file.write(header.render());
+	file.write(data);
+	if (file.error()) {
+		warn("%s: Could not write file", path);
+		file.close();
+		FileIO::remove(path);
+		return false;
+	}
+	file.close();
+
+	return true;
+}
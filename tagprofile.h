@@ -0,0 +1,67 @@
+/* id3ted: tagprofile.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TAGPROFILE_H
+#define TAGPROFILE_H
+
+#include <vector>
+
+#include <taglib/tbytevector.h>
+#include <taglib/id3v2frame.h>
+
+#include "id3ted.h"
+#include "frameinfo.h"
+
+/* a set of id3v2 frames, which is rendered only once and can then be
+ * applied to any number of files: the rendered frames are spliced into
+ * the tags of the files as they are (see MP3File::apply()), the parsed
+ * frames() are only needed to compare them with the frames of a file.
+ * a profile is stored in a file holding a bare id3v2.4 tag without any
+ * padding, so that it can also be inspected with any tag reader. */
+class TagProfile {
+	public:
+		TagProfile() : count(0) {}
+		~TagProfile();
+
+		bool isEmpty() const { return count == 0; }
+		uint size() const { return count; }
+
+		void add(ID3v2::Frame*);
+		bool add(const FrameInfo*);
+		vector<ID3v2::Frame*> createFrames() const;
+		const vector<ID3v2::Frame*>& frames() const { return parsed; }
+		ByteVector rendered(uint) const;
+
+		bool copyFrom(const char*);
+		bool load(const char*);
+		bool save(const char*) const;
+
+	private:
+		ByteVector data;
+		uint count;
+		vector<uint> offsets;
+		vector<ID3v2::Frame*> parsed;
+
+		void index();
+
+		// owns the parsed frames
+		TagProfile(const TagProfile&);
+		TagProfile& operator=(const TagProfile&);
+};
+
+#endif /* TAGPROFILE_H */
@@ -0,0 +1,171 @@
+/* id3ted: tagscanner.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ID3v2 specification:
+ *   http://id3.org/id3v2.3.0
+ *   http://id3.org/id3v2.4.0-structure
+ */
+
+#include "tagscanner.h"
+
+TagScanner::TagScanner(const char *path) :
+		file(path), valid(false), version(0), size(0) {
+	ByteVector header(10, 0);
+	long pos, end;
+	bool unsynced;
+	char flags;
+
+	if (!file.isOpen())
+		return;
+
+	if (file.read(header.data(), 10) != 10 || !header.startsWith("ID3")) {
+		// no tag at all is not an error
+		valid = !file.error();
+		return;
+	}
+
+	version = header[3];
+	if (version < 3 || version > 4)
+		return;
+
+	flags = header[5];
+	unsynced = flags & 0x80;
+	end = 10 + toSize(header.mid(6, 4), true);
+	size = end;
+	if (version == 4 && flags & 0x10)
+		// footer present
+		size += 10;
+	pos = 10;
+
+	if (flags & 0x40) {
+		// skip extended header
+		ByteVector extSize(4, 0);
+		if (file.read(extSize.data(), 4) != 4)
+			return;
+		if (version == 4)
+			pos += toSize(extSize, true);
+		else
+			pos += toSize(extSize, false) + 4;
+	}
+
+	while (pos + 10 <= end) {
+		if (file.seek(pos) != FileIO::Success ||
+				file.read(header.data(), 10) != 10)
+			return;
+		if (header[0] == 0)
+			// reached the padding
+			break;
+
+		RawFrame frame;
+		frame.id = header.mid(0, 4);
+		frame.offset = pos;
+		frame.size = toSize(header.mid(4, 4), version == 4);
+		if (pos + 10 + (long) frame.size > end)
+			break;
+
+		if (version == 4)
+			// grouping, compression, encryption, unsync, data length
+			frame.plain = !unsynced && !(header[9] & 0x4F);
+		else
+			// compression, encryption, grouping
+			frame.plain = !unsynced && !(header[9] & 0xE0);
+
+		frameList.push_back(frame);
+		pos += 10 + frame.size;
+	}
+
+	valid = true;
+}
+
+ByteVector TagScanner::read(const RawFrame &frame, uint offset, uint length) {
+	ByteVector data;
+
+	if (offset >= frame.size)
+		return data;
+	if (length > frame.size - offset)
+		length = frame.size - offset;
+
+	data.resize(length);
+	if (file.seek(frame.offset + 10 + offset) != FileIO::Success ||
+			file.read(data.data(), length) != length)
+		data.clear();
+
+	return data;
+}
+
+/* read the whole frame including its header */
+ByteVector TagScanner::readFrame(const RawFrame &frame) {
+	ByteVector data(10 + frame.size, 0);
+
+	if (file.seek(frame.offset) != FileIO::Success ||
+			file.read(data.data(), data.size()) != data.size())
+		data.clear();
+
+	return data;
+}
+
+/* find the mimetype and the position of the picture data inside an APIC
+ * frame, only reading as much of the frame as needed to skip the
+ * description in front of the picture */
+bool TagScanner::locatePicture(const RawFrame &frame, String &mimetype,
+                               long &offset, long &length) {
+	uint chunk = 256;
+
+	if (!frame.plain || frame.id != "APIC")
+		return false;
+
+	while (true) {
+		ByteVector data = read(frame, 0, chunk);
+		if (data.size() < 4)
+			return false;
+
+		char encoding = data[0];
+		int mimeEnd = data.find(ByteVector(1, 0), 1);
+		uint pos = mimeEnd + 2;
+
+		if (mimeEnd != -1 && encoding != 1 && encoding != 2) {
+			// description is terminated by a single null byte
+			for (; pos < data.size() && data[pos] != 0; ++pos);
+			++pos;
+		} else if (mimeEnd != -1) {
+			// utf-16: terminated by a null character at an even offset
+			for (; pos + 1 < data.size() && (data[pos] != 0 || data[pos+1] != 0);
+			     pos += 2);
+			pos += 2;
+		}
+
+		if (mimeEnd != -1 && pos <= data.size()) {
+			mimetype = String(data.mid(1, mimeEnd - 1));
+			offset = frame.offset + 10 + pos;
+			length = frame.size - pos;
+			return true;
+		}
+		if (data.size() == frame.size || file.error())
+			return false;
+
+		chunk *= 4;
+	}
+}
+
+uint TagScanner::toSize(const ByteVector &data, bool synchsafe) {
+	if (!synchsafe)
+		return data.toUInt();
+
+	return (data[0] & 0x7F) << 21 | (data[1] & 0x7F) << 14 |
+	       (data[2] & 0x7F) << 7  | (data[3] & 0x7F);
+}
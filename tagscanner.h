@@ -0,0 +1,63 @@
+/* id3ted: tagscanner.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TAGSCANNER_H
+#define TAGSCANNER_H
+
+#include <vector>
+
+#include <taglib/tbytevector.h>
+
+#include "id3ted.h"
+#include "fileio.h"
+
+typedef struct {
+	ByteVector id;
+	long offset;   // position of the frame header in the file
+	uint size;     // size of the frame without its header
+	bool plain;    // frame data is neither compressed, encrypted nor unsynced
+} RawFrame;
+
+/* locates the frames of the id3v2 tag at the beginning of a file by only
+ * reading their headers, so that single frames can be read or copied
+ * directly from the file without parsing the whole tag.
+ * supports id3v2.3 and id3v2.4 tags. */
+class TagScanner {
+	public:
+		explicit TagScanner(const char*);
+
+		bool isValid() const { return valid; }
+		uint majorVersion() const { return version; }
+		long tagSize() const { return size; }
+		const vector<RawFrame>& frames() const { return frameList; }
+
+		ByteVector read(const RawFrame&, uint, uint);
+		ByteVector readFrame(const RawFrame&);
+		bool locatePicture(const RawFrame&, String&, long&, long&);
+
+	private:
+		IFile file;
+		bool valid;
+		uint version;
+		long size;
+		vector<RawFrame> frameList;
+
+		static uint toSize(const ByteVector&, bool);
+};
+
+#endif /* TAGSCANNER_H */
@@ -0,0 +1,173 @@
+/* id3ted: writer.cpp
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+
+#include "writer.h"
+
+Writer::Writer(FILE *_stream) :
+		stream(_stream), size(0), written(0), error(false) {
+	buffer = new char[OUT_BUF_SIZE];
+}
+
+Writer::~Writer() {
+	flush();
+	delete [] buffer;
+}
+
+Writer& Writer::operator<<(char c) {
+	if (size == OUT_BUF_SIZE)
+		flush();
+	buffer[size++] = c;
+
+	return *this;
+}
+
+Writer& Writer::operator<<(const char *text) {
+	return write(text, strlen(text));
+}
+
+Writer& Writer::operator<<(const String &text) {
+	return *this << text.toCString(USE_UTF8);
+}
+
+Writer& Writer::operator<<(long number) {
+	if (number < 0) {
+		*this << '-';
+		return *this << (0UL - (unsigned long) number);
+	}
+	return *this << (unsigned long) number;
+}
+
+Writer& Writer::operator<<(unsigned long number) {
+	char digits[24];
+	int pos = sizeof(digits);
+
+	do {
+		digits[--pos] = '0' + number % 10;
+		number /= 10;
+	} while (number > 0);
+
+	return write(digits + pos, sizeof(digits) - pos);
+}
+
+Writer& Writer::write(const char *data, size_t length) {
+	while (length > 0) {
+		size_t chunk = OUT_BUF_SIZE - size;
+
+		if (chunk == 0) {
+			flush();
+			chunk = OUT_BUF_SIZE;
+		}
+		if (chunk > length)
+			chunk = length;
+		memcpy(buffer + size, data, chunk);
+		size += chunk;
+		data += chunk;
+		length -= chunk;
+	}
+
+	return *this;
+}
+
+/* like printf("%-*s"): left aligned, filled up with spaces */
+Writer& Writer::putPadded(const char *text, int width) {
+	unsigned long start = position();
+
+	*this << text;
+	return pad(start, width);
+}
+
+Writer& Writer::putPadded(const String &text, int width) {
+	return putPadded(text.toCString(USE_UTF8), width);
+}
+
+/* like printf("%0*ld") */
+Writer& Writer::putNumber(long number, int width) {
+	char digits[24];
+	int len = snprintf(digits, sizeof(digits), "%0*ld", width, number);
+
+	return write(digits, len);
+}
+
+/* like printf("%0*X") */
+Writer& Writer::putHex(uint number, int width) {
+	char digits[24];
+	int len = snprintf(digits, sizeof(digits), "%0*X", width, number);
+
+	return write(digits, len);
+}
+
+/* like printf("%.*f"), or printf("%+.*f") if sign is true */
+Writer& Writer::putFixed(double number, int precision, bool sign) {
+	char digits[64];
+	int len = snprintf(digits, sizeof(digits), sign ? "%+.*f" : "%.*f",
+	                   precision, number);
+
+	return write(digits, len < (int) sizeof(digits) ? len : sizeof(digits) - 1);
+}
+
+Writer& Writer::putSize(unsigned long bytes) {
+	float size_hr = bytes;
+	const char *unit = NULL;
+
+	if (size_hr >= 1024) {
+		size_hr /= 1024;
+		unit = "KB";
+	}
+	if (size_hr >= 1024) {
+		size_hr /= 1024;
+		unit = "MB";
+	}
+	if (size_hr >= 1024) {
+		size_hr /= 1024;
+		unit = "GB";
+	}
+
+	if (unit != NULL) {
+		putFixed(size_hr, 2);
+		*this << ' ' << unit << " (" << bytes << " bytes)";
+	} else {
+		*this << bytes << " bytes";
+	}
+
+	return *this;
+}
+
+/* fill up with spaces, until width bytes have been written since start */
+Writer& Writer::pad(unsigned long start, int width) {
+	while (position() < start + width)
+		*this << ' ';
+
+	return *this;
+}
+
+bool Writer::flush() {
+	if (size > 0) {
+		if (fwrite(buffer, 1, size, stream) != size)
+			error = true;
+		written += size;
+		size = 0;
+	}
+	if (fflush(stream) != 0)
+		error = true;
+
+	return !error;
+}
+
+Writer Writer::out(stdout);
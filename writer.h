@@ -0,0 +1,67 @@
+/* id3ted: writer.h
+ * Copyright (c) 2011 Bert Muennich <be.muennich at googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <cstdio>
+
+#include "id3ted.h"
+
+/* buffered writer, used for all the output on stdout: the output is
+ * collected in one large buffer, which is only written to the stream,
+ * if it is full or flush() is called. none of the formatting functions
+ * allocate any memory. */
+class Writer {
+	public:
+		explicit Writer(FILE*);
+		~Writer();
+
+		Writer& operator<<(char);
+		Writer& operator<<(const char*);
+		Writer& operator<<(const String&);
+		Writer& operator<<(int number) { return *this << (long) number; }
+		Writer& operator<<(uint number) { return *this << (unsigned long) number; }
+		Writer& operator<<(long);
+		Writer& operator<<(unsigned long);
+
+		Writer& write(const char*, size_t);
+		Writer& putPadded(const char*, int);
+		Writer& putPadded(const String&, int);
+		Writer& putNumber(long, int);
+		Writer& putHex(uint, int);
+		Writer& putFixed(double, int, bool = false);
+		Writer& putSize(unsigned long);
+
+		/* number of bytes written so far, use it as the start for pad() */
+		unsigned long position() const { return written + size; }
+		Writer& pad(unsigned long, int);
+
+		bool flush();
+
+		static Writer out;
+
+	private:
+		FILE *stream;
+		char *buffer;
+		size_t size;
+		unsigned long written;
+		bool error;
+};
+
+#endif /* WRITER_H */